@@ -0,0 +1,628 @@
+/* batch.c - struct-of-arrays simulation of many independent ships flying the
+ * same level
+ * Copyright (C) 2026 FreeCG contributors.
+ *
+ * This file is part of FreeCG.
+ *
+ * FreeCG is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FreeCG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FreeCG. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "batch.h"
+#include "mathgeom.h"
+#include <stdlib.h>
+#include <math.h>
+#include <float.h>
+#include <assert.h>
+
+#define ALLOC(arr, num) (arr) = calloc((num), sizeof(*(arr)))
+
+/* ==================== Setup ==================== */
+void batch_restart_ship(struct cg_batch *b, size_t i)
+{
+	const struct airport *hb = b->l->hb;
+	b->x[i] = hb->base->x + (hb->base->w - SHIP_W)/2;
+	b->y[i] = hb->base->y - 20;
+	b->vx[i] = b->vy[i] = 0;
+	b->rot[i] = 3/2.0 * M_PI; /* vertical */
+	b->rot_speed[i] = 0;
+	b->fuel[i] = MAX_FUEL;
+	b->engine[i] = 0;
+	b->landed[i] = 1;
+	b->alive[i] = 1;
+	b->touched[i] = -1;
+}
+void batch_map_dynamic_tiles(struct cg_batch *b)
+{
+	const struct cgl *l = b->l;
+	ALLOC(b->dyn_kind, l->ntiles);
+	ALLOC(b->dyn_obj, l->ntiles);
+#define MAP(tile, kind, k) \
+	b->dyn_kind[(tile) - l->tiles] = (kind); \
+	b->dyn_obj[(tile) - l->tiles] = (k);
+	for (size_t k = 0; k < l->ngates; ++k) {
+		MAP(l->gates[k].bar, DynGateBar, k)
+	}
+	for (size_t k = 0; k < l->nlgates; ++k) {
+		MAP(l->lgates[k].bar, DynLGateBar, k)
+	}
+	for (size_t k = 0; k < l->nbars; ++k) {
+		MAP(l->bars[k].fbar, DynBarF, k)
+		MAP(l->bars[k].sbar, DynBarS, k)
+	}
+#undef MAP
+}
+/* Creates n ships flying the level l, which must be preprocessed but is
+ * never modified, so it may be shared by many batches */
+struct cg_batch *cg_batch_new(const struct cgl *l, const struct cg_shared *sh,
+		size_t n, uint32_t seed)
+{
+	struct cg_batch *b = calloc(1, sizeof(*b));
+	size_t np = (n + BATCH_LANES - 1) / BATCH_LANES * BATCH_LANES;
+	b->l = l;
+	b->shared = sh;
+	b->n = n, b->np = np;
+	b->time = 0;
+	ALLOC(b->x, np); ALLOC(b->y, np);
+	ALLOC(b->vx, np); ALLOC(b->vy, np);
+	ALLOC(b->rot, np); ALLOC(b->rot_speed, np);
+	ALLOC(b->fuel, np);
+	ALLOC(b->engine, np); ALLOC(b->landed, np); ALLOC(b->alive, np);
+	ALLOC(b->kaboom_end, np);
+	ALLOC(b->keys, np);
+	ALLOC(b->rng, np);
+	ALLOC(b->touched, np);
+	ALLOC(b->fx, np); ALLOC(b->fy, np);
+	ALLOC(b->tx, np); ALLOC(b->ty, np);
+	ALLOC(b->nsub, np); ALLOC(b->h, np);
+	ALLOC(b->decay, np); ALLOC(b->drag_k, np);
+	ALLOC(b->sub, np);
+	ALLOC(b->ndeaths, np); ALLOC(b->nlandings, np);
+	ALLOC(b->gate_len, l->ngates * np);
+	ALLOC(b->gate_active, l->ngates * np);
+	ALLOC(b->fan_mod, l->nfans * np);
+	ALLOC(b->magnet_mod, l->nmagnets * np);
+	ALLOC(b->airgen_active, l->nairgens * np);
+	ALLOC(b->lgate_len, l->nlgates * np);
+	ALLOC(b->lgate_open, l->nlgates * np);
+	ALLOC(b->bar_flen, l->nbars * np);
+	ALLOC(b->bar_slen, l->nbars * np);
+	ALLOC(b->bar_fspeed, l->nbars * np);
+	ALLOC(b->bar_sspeed, l->nbars * np);
+	ALLOC(b->bar_fnext, l->nbars * np);
+	ALLOC(b->bar_snext, l->nbars * np);
+	for (size_t i = 0; i < np; ++i) {
+		batch_restart_ship(b, i);
+		rand_seed(&b->rng[i], seed + i);
+		b->kaboom_end[i] = -DBL_MAX;
+	}
+	for (size_t i = n; i < np; ++i) {
+		b->alive[i] = 0;
+		b->kaboom_end[i] = DBL_MAX;
+	}
+	for (size_t k = 0; k < l->ngates; ++k)
+		for (size_t i = 0; i < np; ++i)
+			b->gate_len[k*np + i] = l->gates[k].max_len;
+	for (size_t k = 0; k < l->nlgates; ++k)
+		for (size_t i = 0; i < np; ++i)
+			b->lgate_len[k*np + i] = l->lgates[k].max_len;
+	for (size_t k = 0; k < l->nbars; ++k)
+		for (size_t i = 0; i < np; ++i) {
+			b->bar_flen[k*np + i] = l->bars[k].flen;
+			b->bar_slen[k*np + i] = l->bars[k].slen;
+		}
+	b->thickness = cg_thickness_map(l);
+	b->max_substeps = SHIP_MAX_SUBSTEPS;
+	ALLOC(b->cannon_next, l->ncannons);
+	for (size_t k = 0; k < l->ncannons; ++k)
+		if (l->cannons[k].fire_rate <= 0 ||
+		    (!l->cannons[k].speed_x && !l->cannons[k].speed_y))
+			b->cannon_next[k] = DBL_MAX;
+	batch_map_dynamic_tiles(b);
+	return b;
+}
+void cg_batch_free(struct cg_batch *b)
+{
+	free(b->x); free(b->y);
+	free(b->vx); free(b->vy);
+	free(b->rot); free(b->rot_speed);
+	free(b->fuel);
+	free(b->engine); free(b->landed); free(b->alive);
+	free(b->kaboom_end);
+	free(b->keys);
+	free(b->rng);
+	free(b->touched);
+	free(b->fx); free(b->fy);
+	free(b->tx); free(b->ty);
+	free(b->nsub); free(b->h);
+	free(b->decay); free(b->drag_k);
+	free(b->sub);
+	free(b->thickness);
+	free(b->ndeaths); free(b->nlandings);
+	free(b->gate_len); free(b->gate_active);
+	free(b->fan_mod); free(b->magnet_mod);
+	free(b->airgen_active);
+	free(b->lgate_len); free(b->lgate_open);
+	free(b->bar_flen); free(b->bar_slen);
+	free(b->bar_fspeed); free(b->bar_sspeed);
+	free(b->bar_fnext); free(b->bar_snext);
+	free(b->cannon_next);
+	free(b->dyn_kind); free(b->dyn_obj);
+	free(b);
+}
+void cg_batch_set_engine(struct cg_batch *b, size_t i, int eng)
+{
+	b->engine[i] = eng && b->fuel[i] > 0;
+}
+/* ==================== /Setup ==================== */
+
+/* ==================== Kernels ==================== */
+/* The vector kernels take pointers already offset to the first ship and
+ * process nb blocks of BATCH_LANES ships. Since the trip count is a known
+ * multiple of the vector width, the compiler vectorizes them without any
+ * scalar epilogue or run-time alias checks, even at -O2. Per-ship
+ * conditions are expressed as selects or multiplications by 0/1 flags
+ * (alive, landed) so that the loop bodies are branchless. */
+void gate_kernel(size_t nb, double ds, double max_len,
+		double *restrict len, double *restrict act)
+{
+	for (size_t j = 0; j < nb * BATCH_LANES; ++j) {
+		double opened = len[j] - ds,
+		       closed = len[j] + ds;
+		opened = opened < GATE_BAR_MIN_LEN ? GATE_BAR_MIN_LEN : opened;
+		closed = closed > max_len ? max_len : closed;
+		len[j] = act[j] != 0 ? opened : closed;
+		act[j] = 0;
+	}
+}
+void batch_step_gates(struct cg_batch *b, size_t beg, size_t end, double dt)
+{
+	const struct cgl *l = b->l;
+	size_t nb = (end - beg) / BATCH_LANES;
+	for (size_t k = 0; k < l->ngates; ++k)
+		gate_kernel(nb, GATE_BAR_SPEED * dt, l->gates[k].max_len,
+				b->gate_len + k*b->np + beg,
+				b->gate_active + k*b->np + beg);
+	for (size_t k = 0; k < l->nlgates; ++k)
+		gate_kernel(nb, GATE_BAR_SPEED * dt, l->lgates[k].max_len,
+				b->lgate_len + k*b->np + beg,
+				b->lgate_open + k*b->np + beg);
+}
+/* bars move randomly, so they are stepped by the scalar routine on a copy */
+void batch_step_bars(struct cg_batch *b, size_t beg, size_t end, double dt)
+{
+	for (size_t k = 0; k < b->l->nbars; ++k) {
+		struct bar bar = b->l->bars[k];
+		size_t o = k*b->np;
+		for (size_t i = beg; i < end; ++i) {
+			bar.flen = b->bar_flen[o + i];
+			bar.slen = b->bar_slen[o + i];
+			bar.fspeed = b->bar_fspeed[o + i];
+			bar.sspeed = b->bar_sspeed[o + i];
+			bar.fchange_due = b->bar_fnext[o + i] <= b->time;
+			bar.schange_due = b->bar_snext[o + i] <= b->time;
+			int changed = cg_move_bar(&bar, &b->rng[i], dt);
+			if (changed & BarFChanged)
+				b->bar_fnext[o + i] =
+					bar_next_change(&b->rng[i], b->time);
+			if (changed & BarSChanged)
+				b->bar_snext[o + i] =
+					bar_next_change(&b->rng[i], b->time);
+			b->bar_flen[o + i] = bar.flen;
+			b->bar_slen[o + i] = bar.slen;
+			b->bar_fspeed[o + i] = bar.fspeed;
+			b->bar_sspeed[o + i] = bar.sspeed;
+		}
+	}
+}
+/* respawning and landing - rare events, handled per ship */
+void batch_step_events(struct cg_batch *b, size_t beg, size_t end)
+{
+	for (size_t i = beg; i < end; ++i) {
+		if (!b->alive[i]) {
+			if (b->kaboom_end[i] <= b->time)
+				batch_restart_ship(b, i);
+			continue;
+		}
+		if (b->touched[i] >= 0) {
+			const struct airport *ap = &b->l->airports[b->touched[i]];
+			b->y[i] = ap->base->y - 20;
+			b->vx[i] = b->vy[i] = 0;
+			if (!b->landed[i])
+				++b->nlandings[i];
+			b->landed[i] = 1;
+			b->touched[i] = -1;
+		}
+	}
+}
+/* Chooses the sub-steps of every ship for a step of dt by the rule of
+ * cg_substeps() and returns the largest number of them */
+size_t batch_substeps(struct cg_batch *b, size_t beg, size_t end, double dt)
+{
+	size_t most = 1;
+	for (size_t i = beg; i < end; ++i) {
+		size_t n = 1;
+		if (b->alive[i] && !b->landed[i] && b->max_substeps > 1)
+			n = cg_substeps_at(b->l, b->thickness, b->x[i], b->y[i],
+					b->vx[i], b->vy[i], dt, b->max_substeps);
+		b->nsub[i] = n;
+		b->h[i] = dt / n;
+		b->decay[i] = b->decay_tab[n];
+		b->drag_k[i] = b->drag_k_tab[n];
+		most = n > most ? n : most;
+	}
+	return most;
+}
+/* A ship takes part in its first nsub sub-steps, unless it dies or touches
+ * an airport - it lands in the next step then, like in cg_step() */
+void batch_substep_mask(struct cg_batch *b, size_t beg, size_t end, size_t k)
+{
+	for (size_t i = beg; i < end; ++i)
+		b->sub[i] = b->alive[i] != 0 && k < b->nsub[i] &&
+			b->touched[i] < 0;
+}
+/* turns the ships which touched one airgen in the last step by dr and
+ * clears the flags; once per step, like cg_step_airgen() */
+void airgen_kernel(size_t nb, double dr, double *restrict rot,
+		double *restrict act)
+{
+	for (size_t j = 0; j < nb * BATCH_LANES; ++j) {
+		double r = rot[j] + dr * act[j];
+		double wrap = r < 0 ? 2*M_PI : r >= 2*M_PI ? -2*M_PI : 0;
+		rot[j] = r + wrap;
+		act[j] = 0;
+	}
+}
+void batch_step_airgens(struct cg_batch *b, size_t beg, size_t end, double dt)
+{
+	const struct cgl *l = b->l;
+	size_t nb = (end - beg) / BATCH_LANES;
+	for (size_t k = 0; k < l->nairgens; ++k)
+		airgen_kernel(nb, (l->airgens[k].spin == CW ? 1 : -1) *
+				AIRGEN_ROT_SPEED * dt, b->rot + beg,
+				b->airgen_active + k*b->np + beg);
+}
+/* the ship's own rotation */
+void rotate_kernel(size_t nb, const double *restrict h,
+		double *restrict rot, const double *restrict rot_speed,
+		const double *restrict landed, const double *restrict sub)
+{
+	for (size_t j = 0; j < nb * BATCH_LANES; ++j) {
+		double r = rot[j] + rot_speed[j] * (1 - landed[j]) * h[j] *
+			sub[j];
+		double wrap = r < 0 ? 2*M_PI : r >= 2*M_PI ? -2*M_PI : 0;
+		rot[j] = r + wrap;
+	}
+}
+/* adds the acceleration of one fan or magnet, (ax, ay) at full strength, to
+ * the ships in the sub-step and clears their modifiers, like cg_step_fan() */
+void field_kernel(size_t nb, double ax, double ay,
+		double *restrict mod, double *restrict fx, double *restrict fy,
+		const double *restrict sub)
+{
+	for (size_t j = 0; j < nb * BATCH_LANES; ++j) {
+		fx[j] += ax * mod[j] * sub[j];
+		fy[j] += ay * mod[j] * sub[j];
+		mod[j] *= 1 - sub[j];
+	}
+}
+static inline double dir_x(enum dir d)
+{
+	return d == Right ? 1 : d == Left ? -1 : 0;
+}
+static inline double dir_y(enum dir d)
+{
+	return d == Down ? 1 : d == Up ? -1 : 0;
+}
+/* the sum over all fans and magnets, as in cg_ship_fields(); fans push
+ * along their direction, magnets pull against it */
+void batch_fields(struct cg_batch *b, size_t beg, size_t end)
+{
+	const struct cgl *l = b->l;
+	size_t nb = (end - beg) / BATCH_LANES;
+	for (size_t i = beg; i < end; ++i)
+		b->fx[i] = b->fy[i] = 0;
+	for (size_t k = 0; k < l->nfans; ++k) {
+		const struct fan *f = &l->fans[k];
+		double a = f->power == Hi ? FAN_HI_ACCEL : FAN_LOW_ACCEL;
+		field_kernel(nb, a * dir_x(f->dir), a * dir_y(f->dir),
+				b->fan_mod + k*b->np + beg,
+				b->fx + beg, b->fy + beg, b->sub + beg);
+	}
+	for (size_t k = 0; k < l->nmagnets; ++k) {
+		const struct magnet *m = &l->magnets[k];
+		field_kernel(nb, -MAGNET_ACCEL * dir_x(m->dir),
+				-MAGNET_ACCEL * dir_y(m->dir),
+				b->magnet_mod + k*b->np + beg,
+				b->fx + beg, b->fy + beg, b->sub + beg);
+	}
+}
+/* engine thrust is looked up by discrete angle, just like the sprite */
+void batch_thrust(struct cg_batch *b, size_t beg, size_t end)
+{
+	for (size_t i = beg; i < end; ++i) {
+		int k = discrete_rot(b->rot[i]);
+		b->tx[i] = b->shared->thrust_x[k] * b->engine[i];
+		b->ty[i] = b->shared->thrust_y[k] * b->engine[i];
+	}
+}
+/* The vector version of cg_ship_move(), split in two loops - the first one
+ * turns engine thrust, gravity and the fields into total acceleration and
+ * decides about taking off, the second one integrates. Fused, gcc threads the landed flag into
+ * branches and gives up on vectorizing. */
+void accel_kernel(size_t nb, const double *restrict h,
+		double *restrict ax, double *restrict ay,
+		const double *restrict fx, const double *restrict fy,
+		double *restrict fuel, double *restrict engine,
+		double *restrict landed, const double *restrict sub)
+{
+	for (size_t j = 0; j < nb * BATCH_LANES; ++j) {
+		/* taking off - the thrust points up */
+		double l = ay[j] < 0 ? 0 : landed[j];
+		landed[j] += (l - landed[j]) * sub[j];
+		/* the engine burns fuel only in flight */
+		double f = fuel[j] - FUEL_SPEED * h[j] * engine[j] * sub[j] *
+			(1 - landed[j]);
+		engine[j] = f < 0 ? 0 : engine[j];
+		fuel[j] = f;
+		/* no gravity and fields on airport */
+		ax[j] = (ax[j] + fx[j]) * (1 - landed[j]);
+		ay[j] = (ay[j] + fy[j] + GRAVITY) * (1 - landed[j]);
+	}
+}
+/* the speed decays exponentially towards the terminal speed, see
+ * cg_ship_move() */
+void move_kernel(size_t nb, const double *restrict h,
+		const double *restrict decay, const double *restrict drag_k,
+		double *restrict x, double *restrict y,
+		double *restrict vx, double *restrict vy,
+		const double *restrict ax, const double *restrict ay,
+		const double *restrict landed, const double *restrict sub)
+{
+	for (size_t j = 0; j < nb * BATCH_LANES; ++j) {
+		/* on an airport the speed is always cleared */
+		double ux = vx[j] * (1 - landed[j]),
+		       uy = vy[j] * (1 - landed[j]),
+		       tx = ax[j] / AIR_RESISTANCE,
+		       ty = ay[j] / AIR_RESISTANCE;
+		double nx = x[j] + tx*h[j] + (ux - tx)*drag_k[j],
+		       ny = y[j] + ty*h[j] + (uy - ty)*drag_k[j];
+		vx[j] += (tx + (ux - tx)*decay[j] - vx[j]) * sub[j];
+		vy[j] += (ty + (uy - ty)*decay[j] - vy[j]) * sub[j];
+		x[j] += (nx - x[j]) * sub[j];
+		y[j] += (ny - y[j]) * sub[j];
+	}
+}
+/* ==================== /Kernels ==================== */
+
+/* ==================== Collisions ==================== */
+/* puts the ship's private version of a dynamic tile t in out */
+const struct tile *batch_tile(const struct cg_batch *b, size_t i,
+		const struct tile *t, struct tile *out)
+{
+	size_t idx = t - b->l->tiles;
+	if (b->dyn_kind[idx] == DynNone)
+		return t;
+	size_t k = b->dyn_obj[idx];
+	struct bar bar;
+	*out = *t;
+	switch (b->dyn_kind[idx]) {
+	case DynGateBar:
+		update_gate_bar(b->l->gates[k].type, out,
+				(int)b->gate_len[k*b->np + i]);
+		break;
+	case DynLGateBar:
+		update_gate_bar(b->l->lgates[k].type, out,
+				(int)b->lgate_len[k*b->np + i]);
+		break;
+	case DynBarF:
+	case DynBarS:
+		bar = b->l->bars[k];
+		bar.flen = b->bar_flen[k*b->np + i];
+		bar.slen = b->bar_slen[k*b->np + i];
+		if (b->dyn_kind[idx] == DynBarF)
+			update_bar_tiles(&bar, out, &(struct tile){0});
+		else
+			update_bar_tiles(&bar, &(struct tile){0}, out);
+		break;
+	}
+	return out;
+}
+void batch_kill(struct cg_batch *b, size_t i)
+{
+	b->alive[i] = 0;
+	b->landed[i] = 0;
+	b->engine[i] = 0;
+	b->kaboom_end[i] = b->time + KABOOM_TIME;
+	++b->ndeaths[i];
+}
+/* the equivalent of cg_call_collision_handler() for ship i */
+void batch_collision_handler(struct cg_batch *b, size_t i,
+		const struct tile *stile, const struct tile *t)
+{
+	const struct cgl *l = b->l;
+	double cx = b->x[i] + SHIP_W/2,
+	       cy = b->y[i] + SHIP_H/2;
+	const struct lgate *lg;
+	const struct airgen *ag;
+	const struct airport *ap;
+	const struct fan *fan;
+	const struct magnet *mg;
+	switch (t->collision_type) {
+	case GateAction:
+		b->gate_active[((struct gate*)t->data - l->gates)*b->np + i] = 1;
+		break;
+	case LGateAction:
+		lg = t->data;
+		b->lgate_open[(lg - l->lgates)*b->np + i] = 1;
+		for (size_t k = 0; k < 4; ++k)
+			if (lg->keys[k] && !(b->keys[i] & 1 << k))
+				b->lgate_open[(lg - l->lgates)*b->np + i] = 0;
+		break;
+	case AirgenAction:
+		ag = t->data;
+		b->airgen_active[(ag - l->airgens)*b->np + i] = 1;
+		break;
+	case AirportAction: {
+		struct tile allowed;
+		ap = t->data;
+		rect_to_tile(&ap->lbbox, &allowed);
+		if (discrete_rot(b->rot[i]) == ROT_UP &&
+				cg_collision_rect_point(stile, &allowed) &&
+				abs((int)b->vx[i]) < SHIP_MAX_VX &&
+				abs((int)b->vy[i]) < SHIP_MAX_VY)
+			b->touched[i] = ap - l->airports;
+		else
+			batch_kill(b, i);
+		break;
+	}
+	case FanAction:
+		fan = t->data;
+		b->fan_mod[(fan - l->fans)*b->np + i] =
+			field_modifier(fan->dir, fan->act, cx, cy);
+		break;
+	case MagnetAction:
+		mg = t->data;
+		b->magnet_mod[(mg - l->magnets)*b->np + i] =
+			field_modifier(mg->dir, mg->act, cx, cy);
+		break;
+	case Kaboom:
+		batch_kill(b, i);
+		break;
+	}
+}
+/* the equivalent of cg_bullet_collisions() for ship i, but the bullet is not
+ * removed - it is still there for the other ships */
+void batch_bullet_collisions(struct cg_batch *b, size_t i,
+		const struct tile *stile)
+{
+	const struct bullets *bl = &b->bullets;
+	double sep[CG_MAX_BULLETS];
+	size_t ng = (bl->n + POOL_LANES - 1) / POOL_LANES;
+	bullets_separation(ng, bl->x, bl->y, b->x[i], b->y[i], sep);
+	struct tile btile = {
+		.w = BULLET_SIDE,
+		.h = BULLET_SIDE,
+		.collision_test = Cannon
+	};
+	for (size_t k = 0; k < bl->n; ++k) {
+		if (sep[k] >= 0)
+			continue;
+		btile.x = iround(bl->x[k]);
+		btile.y = iround(bl->y[k]);
+		if (cg_collision(b->shared, stile, &btile)) {
+			batch_kill(b, i);
+			return;
+		}
+	}
+}
+/* test every ship in the current sub-step against the static level, against
+ * its own dynamic objects and against the bullets */
+void batch_collisions(struct cg_batch *b, size_t beg, size_t end)
+{
+	const struct cgl *l = b->l;
+	for (size_t i = beg; i < end; ++i) {
+		if (!b->sub[i])
+			continue;
+		struct ship s = {
+			.x = b->x[i], .y = b->y[i],
+			.rot = b->rot[i],
+			.orient = discrete_rot(b->rot[i]),
+			.engine = b->engine[i] != 0
+		};
+		struct tile stile, tmp;
+		ship_to_tile(&s, &stile);
+		size_t x = max(0, s.x / BLOCK_SIZE),
+		       y = max(0, s.y / BLOCK_SIZE);
+		int end_x = min(s.x + SHIP_W, l->width * BLOCK_SIZE),
+		    end_y = min(s.y + SHIP_H, l->height * BLOCK_SIZE);
+		for (size_t bj = y; (signed)bj*BLOCK_SIZE < end_y; ++bj)
+			for (size_t bi = x; (signed)bi*BLOCK_SIZE < end_x; ++bi) {
+				block blk = l->blocks[bj][bi];
+				for (size_t k = 0; blk[k] && b->alive[i]; ++k) {
+					const struct tile *t =
+						batch_tile(b, i, blk[k], &tmp);
+					if (cg_collision(b->shared, &stile, t))
+						batch_collision_handler(b, i,
+								&stile, t);
+				}
+			}
+		if (b->alive[i] && b->bullets.n)
+			batch_bullet_collisions(b, i, &stile);
+	}
+}
+/* ==================== /Collisions ==================== */
+
+/* Steps what all ships share by dt, starting at b->time: the cannons which
+ * are due fire and the bullets move. The drag over every possible sub-step
+ * is computed here too. Called once per step, before any range is
+ * stepped. */
+void cg_batch_step_shared(struct cg_batch *b, double dt)
+{
+	const struct cgl *l = b->l;
+	double time = b->time + dt;
+	b->dt = dt;
+	for (size_t n = 1; n <= SHIP_MAX_SUBSTEPS; ++n) {
+		b->decay_tab[n] = exp(-AIR_RESISTANCE*dt/n);
+		b->drag_k_tab[n] = (1 - b->decay_tab[n]) / AIR_RESISTANCE;
+	}
+	for (size_t k = 0; k < l->ncannons; ++k)
+		while (b->cannon_next[k] <= time) {
+			cg_cannon_shoot(&b->bullets, &l->cannons[k], k);
+			b->cannon_next[k] +=
+				CANNON_FIRE_PERIOD / l->cannons[k].fire_rate;
+		}
+	if (b->bullets.n)
+		cg_step_bullets(&b->bullets, dt);
+}
+/* Steps ships [beg, end) by dt, starting at b->time. beg and end must be
+ * multiples of BATCH_LANES. Disjoint ranges may be stepped in parallel,
+ * after cg_batch_step_shared(); the caller advances b->time afterwards. */
+void cg_batch_step_range(struct cg_batch *b, size_t beg, size_t end, double dt)
+{
+	assert(beg % BATCH_LANES == 0 && end % BATCH_LANES == 0);
+	assert(end <= b->np);
+	assert(dt == b->dt);
+	size_t nb = (end - beg) / BATCH_LANES;
+	batch_step_gates(b, beg, end, dt);
+	batch_step_bars(b, beg, end, dt);
+	batch_step_events(b, beg, end);
+	batch_step_airgens(b, beg, end, dt);
+	/* the thrust is looked up again after every sub-step's rotation,
+	 * instead of splitting the step where the orientation changes like
+	 * cg_ship_step() */
+	size_t n = batch_substeps(b, beg, end, dt);
+	for (size_t k = 0; k < n; ++k) {
+		batch_substep_mask(b, beg, end, k);
+		rotate_kernel(nb, b->h + beg, b->rot + beg,
+				b->rot_speed + beg, b->landed + beg,
+				b->sub + beg);
+		batch_thrust(b, beg, end);
+		batch_fields(b, beg, end);
+		accel_kernel(nb, b->h + beg, b->tx + beg, b->ty + beg,
+				b->fx + beg, b->fy + beg,
+				b->fuel + beg, b->engine + beg, b->landed + beg,
+				b->sub + beg);
+		move_kernel(nb, b->h + beg, b->decay + beg, b->drag_k + beg,
+				b->x + beg, b->y + beg, b->vx + beg, b->vy + beg,
+				b->tx + beg, b->ty + beg, b->landed + beg,
+				b->sub + beg);
+		batch_collisions(b, beg, end);
+	}
+}
+void cg_batch_step(struct cg_batch *b, double dt)
+{
+	cg_batch_step_shared(b, dt);
+	cg_batch_step_range(b, 0, b->np, dt);
+	b->time += dt;
+}
@@ -0,0 +1,118 @@
+/* batch.h - struct-of-arrays simulation of many independent ships flying the
+ * same level
+ * Copyright (C) 2026 FreeCG contributors.
+ *
+ * This file is part of FreeCG.
+ *
+ * FreeCG is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FreeCG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FreeCG. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "cg.h"
+#include <stdint.h>
+
+/* Ships are processed in groups of BATCH_LANES, so that the trip counts of
+ * the kernels are a known multiple of the vector width and the compiler can
+ * vectorize them without a scalar remainder */
+enum batch_consts {
+	BATCH_LANES = 8
+};
+/* Kinds of tiles whose geometry is private to each ship */
+enum batch_dyn {
+	DynNone = 0,
+	DynGateBar,
+	DynLGateBar,
+	DynBarF,
+	DynBarS
+};
+/*
+ * All per-ship arrays have np elements (n rounded up to BATCH_LANES), the
+ * padding ships are dead forever. Flags used by the kernels are stored as
+ * 0/1 doubles to keep them branch-free. Per-object state is object-major:
+ * state of object k of ship i is at [k*np + i].
+ */
+struct cg_batch {
+	/* the static level, never modified */
+	const struct cgl *l;
+	const struct cg_shared *shared;
+	size_t n, np;
+	double time;
+	/* ship state */
+	double *x, *y;
+	double *vx, *vy;
+	double *rot, *rot_speed;
+	double *fuel;
+	double *engine,
+	       *landed,
+	       *alive;
+	double *kaboom_end;
+	uint8_t *keys;
+	uint32_t *rng;
+	/* airport touched in the last collision pass, -1 if none */
+	int32_t *touched;
+	/* acceleration by fans and magnets of the current sub-step */
+	double *fx, *fy;
+	/* thrust, then total acceleration of the current sub-step */
+	double *tx, *ty;
+	/* the number of sub-steps of the current step, as in cg_substeps(),
+	 * their length and the drag over that length */
+	size_t *nsub;
+	double *h, *decay, *drag_k;
+	/* 1 if the ship takes part in the current sub-step */
+	double *sub;
+	/* [n] - decay and drag_k of a step split in n sub-steps, computed once
+	 * per step */
+	double dt;
+	double decay_tab[SHIP_MAX_SUBSTEPS + 1],
+	       drag_k_tab[SHIP_MAX_SUBSTEPS + 1];
+	/* the level's thickness map, see cg_thickness_map() */
+	uint8_t *thickness;
+	/* 1 disables sub-stepping */
+	size_t max_substeps;
+	/* dynamic objects */
+	double *gate_len, *gate_active;
+	/* field modifiers set by the last collision pass, see
+	 * cg_handle_collision_fan() */
+	double *fan_mod, *magnet_mod;
+	/* airgens touched in the last step, they turn the ship in the next
+	 * one like cg_step_airgen() */
+	double *airgen_active;
+	double *lgate_len, *lgate_open;
+	double *bar_flen, *bar_slen,
+	       *bar_fspeed, *bar_sspeed,
+	       *bar_fnext, *bar_snext;
+	/* Bullets are shared by all ships: cannons do not look at the ships,
+	 * so a bullet which hits one ship flies on for the others */
+	struct bullets bullets;
+	/* time of the next shot of every cannon */
+	double *cannon_next;
+	/* tile index -> kind and index of the object it belongs to */
+	uint8_t *dyn_kind;
+	uint32_t *dyn_obj;
+	/* statistics, per ship so that ranges may be stepped in parallel */
+	uint32_t *ndeaths,
+		 *nlandings;
+};
+
+struct cg_batch *cg_batch_new(const struct cgl*, const struct cg_shared*,
+		size_t, uint32_t);
+void cg_batch_free(struct cg_batch*);
+void cg_batch_set_engine(struct cg_batch*, size_t, int);
+void cg_batch_step_shared(struct cg_batch*, double);
+void cg_batch_step_range(struct cg_batch*, size_t, size_t, double);
+void cg_batch_step(struct cg_batch*, double);
+
+#endif
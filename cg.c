@@ -19,29 +19,49 @@
 
 #include "cg.h"
 #include "mathgeom.h"
+#include "prof.h"
 #include <stdlib.h>
 #include <math.h>
-#include <float.h>
 #include <assert.h>
 
-collision_map cmap;
+/* Timer ids: the kaboom timer, then one per airport for cargo transfer, then
+ * a pair per bar for speed changes of its first and second part, then one
+ * per cannon for its shots */
+enum {TimerKaboom = 0};
+static inline size_t timer_airport(size_t airport)
+{
+	return TimerKaboom + 1 + airport;
+}
+static inline size_t timer_bar(const struct cgl *l, size_t bar, int second)
+{
+	return timer_airport(l->nairports) + 2*bar + second;
+}
+static inline size_t timer_cannon(const struct cgl *l, size_t cannon)
+{
+	return timer_bar(l, l->nbars, 0) + cannon;
+}
 
 /* ==================== Ship ==================== */
 void cg_revert_held_freigh(struct cgl *l)
 {
 	extern void airport_push_cargo(struct airport*);
-	for (size_t i = 0; i < l->ship->num_freight; ++i)
+	for (size_t i = 0; i < l->ship->num_freight; ++i) {
 		airport_push_cargo(l->ship->freight[i].ap);
+		cg_push_event(l, EvCargoReturned, l->ship->freight[i].ap, NULL,
+				l->ship->freight[i].f);
+	}
 	l->ship->num_freight = 0;
 }
 void cg_restart_ship(struct cgl *l)
 {
 	l->ship->vx = l->ship->vy = 0;
+	l->ship->fx = l->ship->fy = 0;
 	l->ship->rot_speed = 0;
 	l->ship->x = l->hb->base->x + (l->hb->base->w - SHIP_W)/2,
 	l->ship->y = l->hb->base->y - 20;
 	l->ship->engine = 0;
 	l->ship->rot = 3/2.0 * M_PI; /* vertical */
+	l->ship->orient = ROT_UP;
 	l->ship->airport = l->hb;
 	l->ship->fuel = MAX_FUEL;
 	l->ship->dead = 0;
@@ -56,65 +76,274 @@ void cg_ship_init(struct cgl *l)
 	l->ship->freight = calloc(l->num_all_freight,
 			sizeof(*l->ship->freight));
 	/* FIXME: Do something with it */
-	l->ship->max_vx = 42;
-	l->ship->max_vy = 72;
+	l->ship->max_vx = SHIP_MAX_VX;
+	l->ship->max_vy = SHIP_MAX_VY;
 }
 void cg_ship_set_engine(struct ship *ship, int eng)
 {
 	ship->engine = eng && ship->fuel > 0;
 }
-void cg_ship_step(struct ship* s, double dt)
+/* Moves the ship over dt with constant thrust, gravity and fields. The air
+ * resistance is linear in speed, so the motion is solved exactly instead of
+ * by Euler's method. */
+void cg_ship_move(const struct cg_shared *sh, struct ship *s, double dt)
 {
-	double ax = 0, ay = 0;
-	if (!s->airport)
-		cg_ship_rotate(s, s->rot_speed*dt);
-	double drot = discrete_rot(s->rot)/24.0 * 2*M_PI;
+	double ax = s->fx, ay = s->fy + GRAVITY;
 	if (s->engine) {
-		ax = cos(drot) * ENGINE_ACCEL;
-		ay = sin(drot) * ENGINE_ACCEL;
+		ax += sh->thrust_x[s->orient];
+		ay += sh->thrust_y[s->orient];
 		s->fuel -= FUEL_SPEED * dt;
 		if (s->fuel < 0)
 			s->engine = 0;
 	}
-	ax += -s->vx*AIR_RESISTANCE;
-	ay += -s->vy*AIR_RESISTANCE;
-	/* no gravity on airport to prevent multiple airport collision */
-	if (!s->airport)
-		ay += GRAVITY;
-	/* taking off */
-	if (s->airport && ay < 0) {
-		/* cancel any pending cargo transfer */
-		s->airport->sched_cargo_transfer = 0;
+	/* the speed decays exponentially towards the terminal speed */
+	struct cg_drag *d = &s->drag;
+	if (d->dt != dt || d->decay == 0) {
+		d->dt = dt;
+		d->decay = exp(-AIR_RESISTANCE*dt);
+		d->k = (1 - d->decay) / AIR_RESISTANCE;
+	}
+	double decay = d->decay,
+	       tx = ax / AIR_RESISTANCE,
+	       ty = ay / AIR_RESISTANCE,
+	       k = d->k;
+	s->x += tx*dt + (s->vx - tx)*k;
+	s->y += ty*dt + (s->vy - ty)*k;
+	s->vx = tx + (s->vx - tx)*decay;
+	s->vy = ty + (s->vy - ty)*decay;
+}
+/* Integrates the ship's motion over dt. The step is split where the ship
+ * turns to another orientation, so the thrust always points where the sprite
+ * does and the result does not depend on the length of the step. */
+void cg_ship_step(const struct cg_shared *sh, struct ship* s, double dt)
+{
+	const double sector = 2*M_PI / SHIP_NUM_ANGLES;
+	if (s->airport) {
+		/* no gravity and fields on airport to prevent multiple airport
+		 * collision */
+		if (!s->engine || sh->thrust_y[s->orient] >= 0) {
+			s->vx = s->vy = 0;
+			return;
+		}
+		/* taking off */
 		s->airport = NULL;
 	}
-	if (s->airport)
-		/* clear any speed caused by fans, magns, etc. */
-		s->vx = s->vy = 0;
-	s->vx += ax * dt;
-	s->vy += ay * dt;
-	s->x += s->vx * dt;
-	s->y += s->vy * dt;
+	while (dt > 0) {
+		double h = dt;
+		if (s->rot_speed > 0)
+			h = ((s->orient + 1)*sector - s->rot) / s->rot_speed;
+		else if (s->rot_speed < 0)
+			h = (s->orient*sector - s->rot) / s->rot_speed;
+		/* a little past the edge, so that the orientation does change */
+		h = fmin(dt, h + 1e-9);
+		cg_ship_move(sh, s, h);
+		cg_ship_rotate(s, s->rot_speed*h);
+		dt -= h;
+	}
+}
+/* Chooses the number of sub-steps for a step of the ship, so that none of
+ * them carries the ship further than a fraction of the thinnest obstacle
+ * around the path. Otherwise a fast ship could jump over a thin bar between
+ * two collision passes. */
+size_t cg_substeps(const struct cgl *l, const struct ship *s, double dt)
+{
+	if (s->airport || l->max_substeps <= 1)
+		return 1;
+	return cg_substeps_at(l, l->thickness, s->x, s->y, s->vx, s->vy, dt,
+			l->max_substeps);
+}
+/* the rule of cg_substeps() for a flying ship at x, y with speed vx, vy, for
+ * any thickness map of l */
+size_t cg_substeps_at(const struct cgl *l, const uint8_t *thickness,
+		double x, double y, double vx, double vy, double dt,
+		size_t max_substeps)
+{
+	/* the speed can only grow this much during the step, and along
+	 * each axis the ship gets at most this far */
+	double grow = (ENGINE_ACCEL + GRAVITY + FAN_HI_ACCEL) * dt,
+	       dx = (fabs(vx) + grow) * dt,
+	       dy = (fabs(vy) + grow) * dt;
+	int x1 = max(0, (x - dx) / BLOCK_SIZE),
+	    y1 = max(0, (y - dy) / BLOCK_SIZE),
+	    x2 = min((int)l->width - 1, (x + SHIP_W + dx) / BLOCK_SIZE),
+	    y2 = min((int)l->height - 1, (y + SHIP_H + dy) / BLOCK_SIZE);
+	int thin = UINT8_MAX;
+	for (int j = y1; j <= y2; ++j)
+		for (int i = x1; i <= x2; ++i)
+			thin = min(thin, thickness[j*l->width + i]);
+	/* the fewest sub-steps over which the speed, at most
+	 * sqrt(v2) + grow, covers no more than a fraction of the thinnest
+	 * obstacle each; compared squared, so without sqrt() */
+	double v2 = vx*vx + vy*vy,
+	       len = (double)thin / SUBSTEP_THICKNESS_DIV / dt;
+	size_t n = 1;
+	for (; n < max_substeps; ++n) {
+		double v = n*len - grow;
+		if (v >= 0 && v2 <= v*v)
+			break;
+	}
+	return n;
 }
-void cg_ship_kill(struct cgl *l)
+/* finds the thinnest tile the ship can collide with in every block; the
+ * result is [height][width] and has to be freed */
+uint8_t *cg_thickness_map(const struct cgl *l)
 {
+	uint8_t *thickness = malloc(l->width * l->height);
+	for (size_t j = 0; j < l->height; ++j)
+		for (size_t i = 0; i < l->width; ++i) {
+			int thin = UINT8_MAX;
+			block blk = l->blocks[j][i];
+			for (size_t k = 0; blk[k] != NULL; ++k)
+				if (blk[k]->collision_test != NoCollision)
+					thin = min(thin, min(blk[k]->w, blk[k]->h));
+			thickness[j*l->width + i] = max(thin, 1);
+		}
+	return thickness;
+}
+void cg_ship_kill(struct cgl *l, const struct tile *tile)
+{
+	extern void cg_kaboom_start(struct cgl*);
 	l->ship->dead = 1;
-	l->kaboom_end = l->time + 1;
+	timer_arm(&l->timers, TimerKaboom, l->time + KABOOM_TIME);
+	cg_kaboom_start(l);
+	cg_push_event(l, EvShipKilled, NULL, tile, 0);
 }
 void cg_ship_rotate(struct ship *s, double delta)
 {
 	s->rot += delta;
 	normalize_angle(&s->rot);
+	s->orient = discrete_rot(s->rot);
 }
 /* ==================== /Ship ==================== */
 
-void cg_init(struct cgl *l)
+/* ==================== Active lists ==================== */
+void active_init(struct active_list *a, size_t nobjs)
+{
+	a->n = 0;
+	a->idx = calloc(nobjs, sizeof(*a->idx));
+	a->on = calloc(nobjs, sizeof(*a->on));
+}
+void active_free(struct active_list *a)
 {
+	free(a->idx);
+	free(a->on);
+}
+static inline void active_wake(struct active_list *a, size_t i)
+{
+	if (a->on[i])
+		return;
+	a->on[i] = 1;
+	a->idx[a->n++] = i;
+}
+/* Steps every object on the list with the call expression, in which i is the
+ * object's index. Objects for which it returns 0 are put to sleep. */
+#define STEP_ACTIVE(list, call) do {                      \
+	struct active_list *a_ = (list);                  \
+	size_t n_ = 0;                                    \
+	for (size_t j_ = 0; j_ < a_->n; ++j_) {           \
+		size_t i = a_->idx[j_];                   \
+		if (call)                                 \
+			a_->idx[n_++] = i;                \
+		else                                      \
+			a_->on[i] = 0;                    \
+	}                                                 \
+	a_->n = n_;                                       \
+} while (0)
+/* ==================== /Active lists ==================== */
+
+/* ==================== Timers ==================== */
+void cg_fire_timer(void *data, size_t id)
+{
+	extern void cg_airport_transfer(struct cgl*, struct airport*),
+	            cg_ship_respawn(struct cgl*),
+		    cg_cannon_fire(struct cgl*, size_t, double);
+	struct cgl *l = data;
+	if (id == TimerKaboom) {
+		cg_ship_respawn(l);
+	} else if (id < timer_bar(l, 0, 0)) {
+		cg_airport_transfer(l, &l->airports[id - timer_airport(0)]);
+	} else if (id >= timer_cannon(l, 0)) {
+		cg_cannon_fire(l, id - timer_cannon(l, 0),
+				l->timers.timers[id].deadline);
+	} else {
+		size_t k = id - timer_bar(l, 0, 0);
+		if (k % 2)
+			l->bars[k/2].schange_due = 1;
+		else
+			l->bars[k/2].fchange_due = 1;
+	}
+}
+/* ==================== /Timers ==================== */
+
+int cg_shared_init(struct cg_shared *sh, const SDL_Surface *gfx)
+{
+	int err = make_collision_map(gfx, sh->cmap);
+	if (err)
+		return err;
+	for (int k = 0; k < SHIP_NUM_ANGLES; ++k) {
+		double drot = k/(double)SHIP_NUM_ANGLES * 2*M_PI;
+		sh->thrust_x[k] = cos(drot) * ENGINE_ACCEL;
+		sh->thrust_y[k] = sin(drot) * ENGINE_ACCEL;
+	}
+	static const int img_x[] = {SHIP_OFF_IMG_X, SHIP_ON_IMG_X},
+	                 img_y[] = {SHIP_OFF_IMG_Y, SHIP_ON_IMG_Y};
+	for (int e = 0; e < 2; ++e)
+		for (int k = 0; k < SHIP_NUM_ANGLES; ++k)
+			for (int j = 0; j < SHIP_H; ++j) {
+				uint32_t row = 0;
+				for (int i = 0; i < SHIP_W; ++i)
+					if (sh->cmap[img_y[e] + j]
+						    [img_x[e] + k*SHIP_W + i])
+						row |= 1u << i;
+				sh->ship_mask[e][k][j] = row;
+			}
+	return 0;
+}
+
+void cg_init(struct cgl *l, const struct cg_shared *sh, uint32_t seed)
+{
+	l->shared = sh;
+	rand_seed(&l->rng, seed);
 	l->time = 0.0;
+	l->nevents = 0;
 	l->ship = calloc(1, sizeof(*l->ship));
 	cg_ship_init(l);
-	l->kaboom_end = -DBL_MAX;
+	active_init(&l->act_airgens, l->nairgens);
+	active_init(&l->act_gates, l->ngates);
+	active_init(&l->act_lgates, l->nlgates);
+	active_init(&l->act_airports, l->nairports);
+	active_init(&l->act_fans, l->nfans);
+	active_init(&l->act_magnets, l->nmagnets);
+	timer_wheel_init(&l->timers, timer_cannon(l, l->ncannons));
+	l->thickness = cg_thickness_map(l);
+	l->max_substeps = SHIP_MAX_SUBSTEPS;
+	/* bars with random speed changes pick their first speed at once */
+	for (size_t i = 0; i < l->nbars; ++i)
+		l->bars[i].fchange_due = l->bars[i].schange_due = 1;
+	l->bullets.n = 0;
+	l->kaboom.n = 0;
+	for (size_t i = 0; i < l->ncannons; ++i)
+		if (l->cannons[i].fire_rate > 0 &&
+		    (l->cannons[i].speed_x || l->cannons[i].speed_y))
+			timer_arm(&l->timers, timer_cannon(l, i), 0);
 	l->status = Alive;
 }
+void cg_free(struct cgl *l)
+{
+	if (!l->ship)
+		return;
+	free(l->ship->freight);
+	free(l->ship);
+	l->ship = NULL;
+	active_free(&l->act_airgens);
+	active_free(&l->act_gates);
+	active_free(&l->act_lgates);
+	active_free(&l->act_airports);
+	active_free(&l->act_fans);
+	active_free(&l->act_magnets);
+	timer_wheel_free(&l->timers);
+	free(l->thickness);
+}
 
 /* ==================== Collision detectors ==================== */
 /* check if ship's center is inside the tile */
@@ -127,29 +356,68 @@ int cg_collision_rect_point(const struct tile *ship, const struct tile *tile)
 		return 1;
 	return 0;
 }
+/* the rows of the ship's collision mask for the sprite used in stile, which
+ * must come from ship_to_tile() */
+static inline const uint32_t *ship_mask(const struct cg_shared *sh,
+		const struct tile *stile)
+{
+	int engine = stile->tex_y == SHIP_ON_IMG_Y;
+	int sprite = (stile->tex_x -
+			(engine ? SHIP_ON_IMG_X : SHIP_OFF_IMG_X)) / SHIP_W;
+	return sh->ship_mask[engine][sprite];
+}
 /* check if tile t's bounding box collides with the ship within rectangle r,
- * knowing that r's origin in collision map is (img_x, img_y) */
-int cg_collision_rect(const struct rect *r, int img_x, int img_y,
-		__attribute__((unused)) const struct tile *t)
+ * knowing that r's origin in the ship's mask is (sx, sy) */
+int cg_collision_rect(const uint32_t *mask, const struct rect *r,
+		int sx, int sy, __attribute__((unused)) const struct tile *t)
 {
+	uint32_t cols = ((1u << r->w) - 1) << sx;
 	for (unsigned j = 0; j < r->h; ++j)
-		for (unsigned i = 0; i < r->w; ++i)
-			if (cmap[img_y + j][img_x + i])
-				return 1;
+		if (mask[sy + j] & cols)
+			return 1;
 	return 0;
 }
 /* check if tile t collides with the ship within the rectangle r, knowing
- * that r's origin in collision map is (img_x, img_y) */
-int cg_collision_bitmap(const struct rect *r, int img_x, int img_y,
-		const struct tile *t)
+ * that r's origin in the ship's mask is (sx, sy) */
+int cg_collision_bitmap(const collision_map cmap, const uint32_t *mask,
+		const struct rect *r, int sx, int sy, const struct tile *t)
 {
 	int tile_img_x = t->tex_x + (r->x - t->x),
 	    tile_img_y = t->tex_y + (r->y - t->y);
-	for (unsigned j = 0; j < r->h; ++j)
-		for (unsigned i = 0; i < r->w; ++i)
-			if (cmap[img_y + j][img_x + i] &&
-			    cmap[tile_img_y + j][tile_img_x + i])
+	uint32_t cols = ((1u << r->w) - 1) << sx;
+	for (unsigned j = 0; j < r->h; ++j) {
+		uint32_t row = mask[sy + j] & cols;
+		/* only pixels solid in the ship are tested against the tile */
+		for (; row; row &= row - 1) {
+			int i = __builtin_ctz(row) - sx;
+			if (cmap[tile_img_y + j][tile_img_x + i])
 				return 1;
+		}
+	}
+	return 0;
+}
+/* check if the ship represented by stile collides with tile t, using the
+ * collision test chosen for t */
+int cg_collision(const struct cg_shared *sh, const struct tile *stile,
+		const struct tile *t)
+{
+	struct rect r;
+	if (!tiles_intersect(stile, t, &r))
+		return 0;
+	int sx = r.x - stile->x,
+	    sy = r.y - stile->y;
+	switch (t->collision_test) {
+	case RectPoint:
+		return cg_collision_rect_point(stile, t);
+	case Rect:
+	case Cannon:
+		return cg_collision_rect(ship_mask(sh, stile), &r, sx, sy, t);
+	case Bitmap:
+		return cg_collision_bitmap(sh->cmap, ship_mask(sh, stile),
+				&r, sx, sy, t);
+	case NoCollision:
+		break;
+	}
 	return 0;
 }
 /* ==================== /Collision detectors ==================== */
@@ -170,35 +438,11 @@ void cg_handle_collisions(struct cgl *l)
 void cg_handle_collisions_block(struct cgl *l, block blk)
 {
 	extern void cg_call_collision_handler(struct cgl*, struct tile*);
-	struct rect r;
 	struct tile stile;
 	ship_to_tile(l->ship, &stile);
-	for (size_t i = 0; blk[i] != NULL; ++i) {
-		if (!tiles_intersect(&stile, blk[i], &r))
-			continue;
-		int img_x = stile.tex_x + (r.x - stile.x),
-		    img_y = stile.tex_y + (r.y - stile.y);
-		int coll = 0;
-		switch (blk[i]->collision_test) {
-		case RectPoint:
-			coll = cg_collision_rect_point(&stile, blk[i]);
-			break;
-		case Rect:
-			coll = cg_collision_rect(&r, img_x, img_y, blk[i]);
-			break;
-		case Bitmap:
-			coll = cg_collision_bitmap(&r, img_x, img_y, blk[i]);
-			break;
-		case Cannon:
-			/* FIXME */
-			coll = 1;
-			break;
-		case NoCollision:
-			break;
-		}
-		if (coll)
+	for (size_t i = 0; blk[i] != NULL; ++i)
+		if (cg_collision(l->shared, &stile, blk[i]))
 			cg_call_collision_handler(l, blk[i]);
-	}
 }
 void cg_call_collision_handler(struct cgl *l, struct tile *tile)
 {
@@ -209,24 +453,35 @@ void cg_call_collision_handler(struct cgl *l, struct tile *tile)
 		   cg_handle_collision_fan(struct ship*, struct fan*),
 		   cg_handle_collision_magnet(struct ship*, struct magnet*);
 	int killed = 0;
+	/* every handled object is woken up to be stepped */
 	switch (tile->collision_type) {
 	case GateAction:
 		killed = cg_handle_collision_gate((struct gate*)tile->data);
+		active_wake(&l->act_gates, (struct gate*)tile->data - l->gates);
 		break;
 	case LGateAction:
 		killed = cg_handle_collision_lgate(l->ship, (struct lgate*)tile->data);
+		active_wake(&l->act_lgates,
+				(struct lgate*)tile->data - l->lgates);
 		break;
 	case AirgenAction:
 		killed = cg_handle_collision_airgen((struct airgen*)tile->data);
+		active_wake(&l->act_airgens,
+				(struct airgen*)tile->data - l->airgens);
 		break;
 	case AirportAction:
 		killed = cg_handle_collision_airport(l->ship, (struct airport*)tile->data);
+		active_wake(&l->act_airports,
+				(struct airport*)tile->data - l->airports);
 		break;
 	case FanAction:
 		killed = cg_handle_collision_fan(l->ship, (struct fan*)tile->data);
+		active_wake(&l->act_fans, (struct fan*)tile->data - l->fans);
 		break;
 	case MagnetAction:
 		killed = cg_handle_collision_magnet(l->ship, (struct magnet*)tile->data);
+		active_wake(&l->act_magnets,
+				(struct magnet*)tile->data - l->magnets);
 		break;
 	case Kaboom:
 		killed = 1;
@@ -235,83 +490,144 @@ void cg_call_collision_handler(struct cgl *l, struct tile *tile)
 	/* remember that collision detection handler may be called multiple
 	 * times per step! */
 	if (killed && !l->ship->dead)
-		cg_ship_kill(l);
+		cg_ship_kill(l, tile);
 }
 
-void cg_kaboom_step(struct cgl *l)
-{
-	/* FIXME: step kaboom */
-}
-void cg_objects_animate(struct cgl *l, double time)
-{
-	extern void animate_fan(struct fan*, double),
-	            animate_magnet(struct magnet*, double),
-	            animate_airgen(struct airgen*, double),
-	            animate_bar(struct bar*, double),
-	            animate_key(struct airport*, double);
-	for (size_t i = 0; i < l->nmagnets; ++i)
-		animate_magnet(&l->magnets[i], time);
-	for (size_t i = 0; i < l->nfans; ++i)
-		animate_fan(&l->fans[i], time);
-	for (size_t i = 0; i < l->nairgens; ++i)
-		animate_airgen(&l->airgens[i], time);
-	for (size_t i = 0; i < l->nbars; ++i)
-		animate_bar(&l->bars[i], time);
-	for (size_t i = 0; i < l->nairports; ++i)
-		animate_key(&l->airports[i], time);
+/* ==================== Kaboom ==================== */
+/* Scatters the debris of the ship. Particles get their own random generator,
+ * seeded with the number of events so far, so that the simulation's random
+ * sequence does not depend on them. */
+void cg_kaboom_start(struct cgl *l)
+{
+	struct particles *p = &l->kaboom;
+	const struct ship *s = l->ship;
+	uint32_t rng;
+	rand_seed(&rng, l->nevents);
+	p->n = KABOOM_PARTICLES;
+	for (size_t i = 0; i < KABOOM_PARTICLES; ++i) {
+		double a = rand_unit(&rng) * 2*M_PI,
+		       v = (0.2 + 0.8*rand_unit(&rng)) * KABOOM_SPEED;
+		p->x[i] = s->x + SHIP_W/2.0;
+		p->y[i] = s->y + SHIP_H/2.0;
+		p->vx[i] = s->vx + v*cos(a);
+		p->vy[i] = s->vy + v*sin(a);
+		p->ttl[i] = (0.5 + 0.5*rand_unit(&rng)) * KABOOM_TIME;
+	}
 }
-/* perform logic simulation of all objects */
+/* Moves the particles like the ship without its engine, vectorized over
+ * groups of POOL_LANES. */
+void particles_move(size_t ng, double *restrict x, double *restrict y,
+		double *restrict vx, double *restrict vy,
+		double *restrict ttl, double dt)
+{
+	double drag = 1 - AIR_RESISTANCE*dt;
+	for (size_t i = 0; i < ng * POOL_LANES; ++i) {
+		vx[i] *= drag;
+		vy[i] = vy[i]*drag + GRAVITY*dt;
+		x[i] += vx[i] * dt;
+		y[i] += vy[i] * dt;
+		ttl[i] -= dt;
+	}
+}
+/* debris keeps flying after the ship is restarted until it fades out */
+void cg_kaboom_step(struct particles *p, double dt)
+{
+	size_t ng = (p->n + POOL_LANES - 1) / POOL_LANES;
+	particles_move(ng, p->x, p->y, p->vx, p->vy, p->ttl, dt);
+	/* all particles live at most KABOOM_TIME, only drop them at the end */
+	for (size_t i = 0; i < p->n; ++i)
+		if (p->ttl[i] > 0)
+			return;
+	p->n = 0;
+}
+/* ==================== /Kaboom ==================== */
+
+/* perform logic simulation of all awake objects; bars move all the time */
 void cg_objects_step(struct cgl *l, double time, double dt)
 {
-	extern void cg_step_airgen(struct airgen*, struct ship*, double),
-	            cg_step_bar(struct bar*, double, double),
-	            cg_step_gate(struct gate*, double),
-	            cg_step_lgate(struct lgate*, struct ship*, double),
-		    cg_step_airport(struct airport*, struct ship*, double),
-		    cg_step_fan(struct fan*, struct ship*, double),
-		    cg_step_magnet(struct magnet*, struct ship*, double);
-	for (size_t i = 0; i < l->nairgens; ++i)
-		cg_step_airgen(&l->airgens[i], l->ship, dt);
+	extern void cg_step_bar(struct cgl*, struct bar*, double, double),
+	            cg_step_bullets(struct bullets*, double),
+	            cg_kaboom_step(struct particles*, double);
+	extern int cg_step_airgen(struct airgen*, struct ship*, double),
+	           cg_step_gate(struct cgl*, struct gate*, double),
+	           cg_step_lgate(struct cgl*, struct lgate*, double),
+		   cg_step_airport(struct cgl*, struct airport*, double);
+	STEP_ACTIVE(&l->act_airgens,
+			cg_step_airgen(&l->airgens[i], l->ship, dt));
 	for (size_t i = 0; i < l->nbars; ++i)
-		cg_step_bar(&l->bars[i], time, dt);
-	for (size_t i = 0; i < l->ngates; ++i)
-		cg_step_gate(&l->gates[i], dt);
-	for (size_t i = 0; i < l->nlgates; ++i)
-		cg_step_lgate(&l->lgates[i], l->ship, dt);
-	for (size_t i = 0; i < l->nairports; ++i)
-		cg_step_airport(&l->airports[i], l->ship, time);
-	for (size_t i = 0; i < l->nfans; ++i)
-		cg_step_fan(&l->fans[i], l->ship, dt);
-	for (size_t i = 0; i < l->nmagnets; ++i)
-		cg_step_magnet(&l->magnets[i], l->ship, dt);
+		cg_step_bar(l, &l->bars[i], time, dt);
+	STEP_ACTIVE(&l->act_gates, cg_step_gate(l, &l->gates[i], dt));
+	STEP_ACTIVE(&l->act_lgates, cg_step_lgate(l, &l->lgates[i], dt));
+	STEP_ACTIVE(&l->act_airports,
+			cg_step_airport(l, &l->airports[i], time));
+	if (l->bullets.n)
+		cg_step_bullets(&l->bullets, dt);
+	if (l->kaboom.n)
+		cg_kaboom_step(&l->kaboom, dt);
+}
+/* sums up the acceleration of fans and magnets which the ship is in */
+void cg_ship_fields(struct cgl *l)
+{
+	extern int cg_step_fan(struct fan*, struct ship*),
+	           cg_step_magnet(struct magnet*, struct ship*);
+	l->ship->fx = l->ship->fy = 0;
+	STEP_ACTIVE(&l->act_fans, cg_step_fan(&l->fans[i], l->ship));
+	STEP_ACTIVE(&l->act_magnets, cg_step_magnet(&l->magnets[i], l->ship));
 }
 void cg_step(struct cgl *l, double time)
 {
+	extern void cg_bullet_collisions(struct cgl*);
 	double dt = time - l->time;
-	cg_objects_animate(l, time);
+	/* everything which happens in this step, events included, happens at
+	 * its end */
+	l->time = time;
+	timer_advance(&l->timers, time, cg_fire_timer, l);
+	PROF_BEGIN_AT(l->prof, ProfObjectsStep);
 	cg_objects_step(l, time, dt);
+	PROF_END_AT(l->prof, ProfObjectsStep);
 	if (l->hb->num_cargo == l->num_all_freight) {
+		if (l->status != Victory)
+			cg_push_event(l, EvVictory, NULL, NULL, 0);
 		l->status = Victory;
-		goto end;
+		return;
 	}
 	if (l->status == Lost)
-		goto end;
-	if (!l->ship->dead) {
-		cg_ship_step(l->ship, dt);
+		return;
+	/* Collisions are handled after every sub-step. A touched airport
+	 * lands the ship in the next step, so the sub-steps stop there. */
+	size_t n = cg_substeps(l, l->ship, dt);
+	for (size_t k = 0; k < n && !l->ship->dead; ++k) {
+		if (k > 0 && l->act_airports.n)
+			break;
+		struct airport *airport = l->ship->airport;
+		PROF_BEGIN_AT(l->prof, ProfShipStep);
+		cg_ship_fields(l);
+		cg_ship_step(l->shared, l->ship, dt / n);
+		PROF_END_AT(l->prof, ProfShipStep);
+		if (airport && !l->ship->airport) {
+			/* cancel any pending cargo transfer */
+			timer_cancel(&l->timers,
+					timer_airport(airport - l->airports));
+			cg_push_event(l, EvTakeoff, airport, NULL, 0);
+		}
+		PROF_BEGIN_AT(l->prof, ProfCollisions);
 		cg_handle_collisions(l);
+		if (l->bullets.n)
+			cg_bullet_collisions(l);
+		PROF_END_AT(l->prof, ProfCollisions);
+	}
+}
+/* called when the kaboom after the ship's death is over */
+void cg_ship_respawn(struct cgl *l)
+{
+	--l->ship->life;
+	if (l->ship->life == -1) {
+		l->status = Lost;
+		cg_push_event(l, EvLost, NULL, NULL, 0);
 	} else {
-		if (l->kaboom_end > time) {
-			cg_kaboom_step(l);
-		} else {
-			--l->ship->life;
-			if (l->ship->life == -1)
-				l->status = Lost;
-			else
-				cg_restart_ship(l);
-		}
+		cg_restart_ship(l);
+		cg_push_event(l, EvShipRestarted, l->hb, NULL, l->ship->life);
 	}
-end:
-	l->time = time;
 }
 
 /* ==================== Collision handlers ==================== */
@@ -339,7 +655,7 @@ int cg_handle_collision_airport(struct ship *ship, struct airport *airport)
 	struct tile allowed, stile;
 	rect_to_tile(&airport->lbbox, &allowed);
 	ship_to_tile(ship, &stile);
-	if (discrete_rot(ship->rot) == ROT_UP &&
+	if (ship->orient == ROT_UP &&
 			cg_collision_rect_point(&stile, &allowed) &&
 			abs(ship->vx) < ship->max_vx &&
 			abs(ship->vy) < ship->max_vy)
@@ -348,7 +664,8 @@ int cg_handle_collision_airport(struct ship *ship, struct airport *airport)
 		return 1;
 	return 0;
 }
-double field_modifier(enum dir dir, struct tile *act, struct ship *ship)
+/* strength of a fan's or magnet's field at the point (x, y) */
+double field_modifier(enum dir dir, const struct tile *act, double x, double y)
 {
 	int beg = 0;
 	double modifier = 0;
@@ -361,23 +678,25 @@ double field_modifier(enum dir dir, struct tile *act, struct ship *ship)
 	switch (dir) {
 	case Up:
 	case Down:
-		modifier = 1 - fabs(beg - (ship->y + SHIP_H/2)) / act->h;
+		modifier = 1 - fabs(beg - y) / act->h;
 		break;
 	case Left:
 	case Right:
-		modifier = 1 - fabs(beg - (ship->x + SHIP_W/2)) / act->w;
+		modifier = 1 - fabs(beg - x) / act->w;
 		break;
 	}
 	return modifier;
 }
 int cg_handle_collision_fan(struct ship *ship, struct fan *fan)
 {
-	fan->modifier = field_modifier(fan->dir, fan->act, ship);
+	fan->modifier = field_modifier(fan->dir, fan->act,
+			ship->x + SHIP_W/2, ship->y + SHIP_H/2);
 	return 0;
 }
 int cg_handle_collision_magnet(struct ship *ship, struct magnet *magnet)
 {
-	magnet->modifier = field_modifier(magnet->dir, magnet->act, ship);
+	magnet->modifier = field_modifier(magnet->dir, magnet->act,
+			ship->x + SHIP_W/2, ship->y + SHIP_H/2);
 	return 0;
 }
 /* ==================== /Collision handlers ==================== */
@@ -407,28 +726,32 @@ void update_sliding_tile(enum dir dir, struct tile *t, int len)
 }
 
 static const double bar_speeds[] = {5.65, 7.43, 10.83, 21.67, 43.33, 69.33};
-static inline double bar_rand_speed(const struct bar *bar)
+static inline double bar_rand_speed(const struct bar *bar, uint32_t *rng)
 {
-	return bar_speeds[rand_range(bar->min_s, bar->max_s)];
+	return bar_speeds[rand_range(rng, bar->min_s, bar->max_s)];
 }
-inline double bar_next_change(double time)
+double bar_next_change(uint32_t *rng, double time)
 {
-	return time + (rand()/(float)RAND_MAX + 0.5) *
-		BAR_SPEED_CHANGE_INTERVAL;
+	return time + (rand_unit(rng) + 0.5) * BAR_SPEED_CHANGE_INTERVAL;
 }
-void cg_step_bar(struct bar *bar, double time, double dt)
+/* Changes lengths of the bar's parts, without touching its tiles. Returns
+ * BarFChanged and/or BarSChanged when a due random speed change was made,
+ * after which the caller schedules the next one. */
+int cg_move_bar(struct bar *bar, uint32_t *rng, double dt)
 {
+	int changed = 0;
 	if (bar->flen + bar->slen > bar->len) {
 		bar->slen = bar->len - bar->flen;
-		bar->fspeed = -bar_rand_speed(bar);
-		bar->sspeed = -bar_rand_speed(bar);
+		bar->fspeed = -bar_rand_speed(bar, rng);
+		bar->sspeed = -bar_rand_speed(bar, rng);
 	} else if (bar->flen <= BAR_MIN_LEN) {
-		bar->fspeed = bar_rand_speed(bar);
+		bar->fspeed = bar_rand_speed(bar, rng);
 	} else if (bar->gap_type == Constant && bar->slen <= BAR_MIN_LEN) {
-		bar->fspeed = -bar_rand_speed(bar);
-	} else if (bar->freq && bar->fnext_change <= time) {
-		bar->fspeed = rand_sign() * bar_rand_speed(bar);
-		bar->fnext_change = bar_next_change(time);
+		bar->fspeed = -bar_rand_speed(bar, rng);
+	} else if (bar->freq && bar->fchange_due) {
+		bar->fspeed = rand_sign(rng) * bar_rand_speed(bar, rng);
+		bar->fchange_due = 0;
+		changed |= BarFChanged;
 	}
 	bar->flen += bar->fspeed * dt;
 	bar->flen = fmin(bar->len, fmax(BAR_MIN_LEN, bar->flen));
@@ -438,26 +761,44 @@ void cg_step_bar(struct bar *bar, double time, double dt)
 		break;
 	case Variable:
 		if (bar->slen <= BAR_MIN_LEN) {
-			bar->sspeed = bar_rand_speed(bar);
-		} else if (bar->freq && bar->snext_change <= time) {
-			bar->sspeed = rand_sign() * bar_rand_speed(bar);
-			bar->snext_change = bar_next_change(time);
+			bar->sspeed = bar_rand_speed(bar, rng);
+		} else if (bar->freq && bar->schange_due) {
+			bar->sspeed = rand_sign(rng) * bar_rand_speed(bar, rng);
+			bar->schange_due = 0;
+			changed |= BarSChanged;
 		}
 		bar->slen += bar->sspeed * dt;
 		break;
 	}
 	bar->slen = fmin(bar->len, fmax(BAR_MIN_LEN, bar->slen));
+	return changed;
+}
+void update_bar_tiles(const struct bar *bar, struct tile *fbar,
+		struct tile *sbar)
+{
 	switch (bar->orientation) {
 	case Vertical:
-		update_sliding_tile(Down, bar->fbar, (int)bar->flen);
-		update_sliding_tile(Up, bar->sbar, (int)bar->slen);
+		update_sliding_tile(Down, fbar, (int)bar->flen);
+		update_sliding_tile(Up, sbar, (int)bar->slen);
 		break;
 	case Horizontal:
-		update_sliding_tile(Right, bar->fbar, (int)bar->flen);
-		update_sliding_tile(Left, bar->sbar, (int)bar->slen);
+		update_sliding_tile(Right, fbar, (int)bar->flen);
+		update_sliding_tile(Left, sbar, (int)bar->slen);
 		break;
 	}
 }
+void cg_step_bar(struct cgl *l, struct bar *bar, double time, double dt)
+{
+	size_t i = bar - l->bars;
+	int changed = cg_move_bar(bar, &l->rng, dt);
+	if (changed & BarFChanged)
+		timer_arm(&l->timers, timer_bar(l, i, 0),
+				bar_next_change(&l->rng, time));
+	if (changed & BarSChanged)
+		timer_arm(&l->timers, timer_bar(l, i, 1),
+				bar_next_change(&l->rng, time));
+	update_bar_tiles(bar, bar->fbar, bar->sbar);
+}
 
 void update_gate_bar(enum gate_type type, struct tile *bar, int len)
 {
@@ -477,8 +818,11 @@ void update_gate_bar(enum gate_type type, struct tile *bar, int len)
 	}
 }
 
-void cg_step_gate(struct gate *gate, double dt)
+/* The object simulators return 0 when the object may go to sleep */
+int cg_step_gate(struct cgl *l, struct gate *gate, double dt)
 {
+	if (gate->active && gate->len >= gate->max_len)
+		cg_push_event(l, EvGateOpened, NULL, gate->bar, 0);
 	if (!gate->active && gate->len < gate->max_len)
 		gate->len = fmin(gate->max_len,
 				gate->len + GATE_BAR_SPEED * dt);
@@ -487,10 +831,16 @@ void cg_step_gate(struct gate *gate, double dt)
 				gate->len - GATE_BAR_SPEED * dt);
 	update_gate_bar(gate->type, gate->bar, (int)gate->len);
 	gate->active = 0;
+	return gate->len < gate->max_len;
 }
 
-void cg_step_lgate(struct lgate *lgate, struct ship *ship, double dt)
+int cg_step_lgate(struct cgl *l, struct lgate *lgate, double dt)
 {
+	struct ship *ship = l->ship;
+	/* lights are turned off one step after the ship leaves */
+	int lit = lgate->active;
+	if (lgate->open && lgate->len >= lgate->max_len)
+		cg_push_event(l, EvGateOpened, NULL, lgate->bar, 0);
 	for (size_t i = 0; i < 4; ++i) {
 		if (!lgate->active) {
 			lgate->light[i]->type = Transparent;
@@ -512,12 +862,13 @@ void cg_step_lgate(struct lgate *lgate, struct ship *ship, double dt)
 	update_gate_bar(lgate->type, lgate->bar, (int)lgate->len);
 	lgate->open = 0;
 	lgate->active = 0;
+	return lit || lgate->len < lgate->max_len;
 }
 
-void cg_step_airgen(struct airgen *airgen, struct ship *ship, double dt)
+int cg_step_airgen(struct airgen *airgen, struct ship *ship, double dt)
 {
 	if (!airgen->active)
-		return;
+		return 0;
 	switch (airgen->spin) {
 	case CW:
 		cg_ship_rotate(ship, AIRGEN_ROT_SPEED * dt);
@@ -527,71 +878,191 @@ void cg_step_airgen(struct airgen *airgen, struct ship *ship, double dt)
 		break;
 	}
 	airgen->active = 0;
+	return 0;
 }
 
-void cg_step_airport(struct airport *airport, struct ship *ship, double time)
+/* fired by the airport's timer a second after the ship has landed */
+void cg_airport_transfer(struct cgl *l, struct airport *airport)
 {
-	extern void airport_schedule_transfer(struct airport*, double),
-	            airport_pop_cargo(struct airport*),
+	extern void airport_pop_cargo(struct airport*),
 		    ship_load_freight(struct ship*, struct airport*),
 		    ship_unload_freight(struct ship*, struct airport*);
-	if (airport->sched_cargo_transfer && airport->transfer_time < time) {
-		airport->sched_cargo_transfer = 0;
-		switch (airport->type) {
-		case Key:
-			ship->keys[airport->c.key] = 1;
-			airport_pop_cargo(airport);
-			break;
-		case Extras:
-			switch (airport->c.extras[airport->num_cargo - 1]) {
-			case Turbo:
-				ship->has_turbo = 1; break;
-			case Cargo:
-				++ship->max_freight; break;
-			case Life:
-				++ship->life; break;
-			}
-			airport_pop_cargo(airport);
-			break;
-		case Freight:
-			ship_load_freight(ship, airport);
-			break;
-		case Homebase:
-			ship_unload_freight(ship, airport);
-			break;
-		case Fuel:
-			ship->fuel = min(MAX_FUEL, ship->fuel + FUEL_BARREL);
-			airport_pop_cargo(airport);
-			break;
+	struct ship *ship = l->ship;
+	int extra;
+	switch (airport->type) {
+	case Key:
+		ship->keys[airport->c.key] = 1;
+		airport_pop_cargo(airport);
+		cg_push_event(l, EvKeyPickup, airport, NULL, airport->c.key);
+		break;
+	case Extras:
+		switch (extra = airport->c.extras[airport->num_cargo - 1]) {
+		case Turbo:
+			ship->has_turbo = 1; break;
+		case Cargo:
+			++ship->max_freight; break;
+		case Life:
+			++ship->life; break;
 		}
+		airport_pop_cargo(airport);
+		cg_push_event(l, EvExtraPickup, airport, NULL, extra);
+		break;
+	case Freight:
+		ship_load_freight(ship, airport);
+		cg_push_event(l, EvCargoLoaded, airport, NULL,
+				ship->freight[ship->num_freight-1].f);
+		break;
+	case Homebase:
+		ship_unload_freight(ship, airport);
+		cg_push_event(l, EvCargoUnloaded, airport, NULL,
+				airport->c.freight[airport->num_cargo-1].f);
+		break;
+	case Fuel:
+		ship->fuel = min(MAX_FUEL, ship->fuel + FUEL_BARREL);
+		airport_pop_cargo(airport);
+		cg_push_event(l, EvFuelPickup, airport, NULL, 0);
+		break;
 	}
+}
+int cg_step_airport(struct cgl *l, struct airport *airport, double time)
+{
+	extern void airport_schedule_transfer(struct cgl*, struct airport*,
+			double);
+	struct ship *ship = l->ship;
 	if (!airport->ship_touched)
-		return;
+		return 0;
+	if (ship->airport != airport)
+		cg_push_event(l, EvLanded, airport, NULL, 0);
 	ship->y = airport->base->y - 20;
 	ship->vx = ship->vy = 0;
 	ship->airport = airport;
 	switch (airport->type) {
 	case Freight:
 		if (airport->num_cargo > 0 && ship->num_freight < ship->max_freight)
-			airport_schedule_transfer(airport, time);
+			airport_schedule_transfer(l, airport, time);
 		break;
 	case Extras:
 	case Key:
 		if (airport->num_cargo > 0)
-			airport_schedule_transfer(airport, time);
+			airport_schedule_transfer(l, airport, time);
 		break;
 	case Fuel:
 		if (airport->num_cargo > 0 && ship->fuel <= MAX_FUEL - 1)
-			airport_schedule_transfer(airport, time);
+			airport_schedule_transfer(l, airport, time);
 		break;
 	case Homebase:
 		if (ship->num_freight > 0)
-			airport_schedule_transfer(airport, time);
+			airport_schedule_transfer(l, airport, time);
 		break;
 	}
 	airport->ship_touched = 0;
+	return 0;
 }
 
+/* ==================== Cannons ==================== */
+/* Puts a bullet of the i-th cannon, c, at its beginning, flying towards its
+ * catcher. The shot is skipped while the pool is full. */
+void cg_cannon_shoot(struct bullets *b, const struct cannon *c, size_t i)
+{
+	double vx = c->speed_x * CANNON_SPEED_SCALE,
+	       vy = c->speed_y * CANNON_SPEED_SCALE,
+	       dx = c->end.x - c->beg.x,
+	       dy = c->end.y - c->beg.y;
+	if (b->n == CG_MAX_BULLETS)
+		return;
+	size_t k = b->n++;
+	b->x[k] = c->beg.x - BULLET_SIDE/2;
+	b->y[k] = c->beg.y - BULLET_SIDE/2;
+	b->vx[k] = vx;
+	b->vy[k] = vy;
+	b->ttl[k] = sqrt((dx*dx + dy*dy) / (vx*vx + vy*vy));
+	b->cannon[k] = i;
+}
+/* shoots and schedules the next shot */
+void cg_cannon_fire(struct cgl *l, size_t i, double time)
+{
+	const struct cannon *c = &l->cannons[i];
+	timer_arm(&l->timers, timer_cannon(l, i),
+			time + CANNON_FIRE_PERIOD / c->fire_rate);
+	cg_cannon_shoot(&l->bullets, c, i);
+}
+/* Moves every bullet in the pool, in groups of POOL_LANES so that the
+ * loop is vectorized. The lanes past the live bullets are moved too, their
+ * contents do not matter. */
+void bullets_move(size_t ng, double *restrict x, double *restrict y,
+		const double *restrict vx, const double *restrict vy,
+		double *restrict ttl, double dt)
+{
+	for (size_t i = 0; i < ng * POOL_LANES; ++i) {
+		x[i] += vx[i] * dt;
+		y[i] += vy[i] * dt;
+		ttl[i] -= dt;
+	}
+}
+static inline void bullet_remove(struct bullets *b, size_t i)
+{
+	size_t last = --b->n;
+	b->x[i] = b->x[last];
+	b->y[i] = b->y[last];
+	b->vx[i] = b->vx[last];
+	b->vy[i] = b->vy[last];
+	b->ttl[i] = b->ttl[last];
+	b->cannon[i] = b->cannon[last];
+}
+/* bullets which reached their catchers disappear */
+void cg_step_bullets(struct bullets *b, double dt)
+{
+	size_t ng = (b->n + POOL_LANES - 1) / POOL_LANES;
+	bullets_move(ng, b->x, b->y, b->vx, b->vy, b->ttl, dt);
+	for (size_t i = 0; i < b->n; )
+		if (b->ttl[i] <= 0)
+			bullet_remove(b, i);
+		else
+			++i;
+}
+/* Computes how far apart each bullet's box is from the ship's box, in one
+ * vectorized pass; it is negative for overlapping boxes. Only the bullets
+ * overlapping the ship get the exact test. */
+void bullets_separation(size_t ng, const double *restrict x,
+		const double *restrict y, double sx, double sy,
+		double *restrict sep)
+{
+	for (size_t i = 0; i < ng * POOL_LANES; ++i) {
+		double dx = x[i] - sx,
+		       dy = y[i] - sy;
+		double lx = -BULLET_SIDE - dx, rx = dx - SHIP_W,
+		       ly = -BULLET_SIDE - dy, ry = dy - SHIP_H;
+		double ex = lx > rx ? lx : rx,
+		       ey = ly > ry ? ly : ry;
+		sep[i] = ex > ey ? ex : ey;
+	}
+}
+void cg_bullet_collisions(struct cgl *l)
+{
+	struct bullets *b = &l->bullets;
+	double sep[CG_MAX_BULLETS];
+	size_t ng = (b->n + POOL_LANES - 1) / POOL_LANES;
+	bullets_separation(ng, b->x, b->y, l->ship->x, l->ship->y, sep);
+	struct tile stile, btile = {
+		.w = BULLET_SIDE,
+		.h = BULLET_SIDE,
+		.collision_test = Cannon
+	};
+	ship_to_tile(l->ship, &stile);
+	for (size_t i = 0; i < b->n; ++i) {
+		if (sep[i] >= 0)
+			continue;
+		btile.x = iround(b->x[i]);
+		btile.y = iround(b->y[i]);
+		if (cg_collision(l->shared, &stile, &btile)) {
+			cg_ship_kill(l, l->cannons[b->cannon[i]].beg_cano);
+			bullet_remove(b, i);
+			return;
+		}
+	}
+}
+/* ==================== /Cannons ==================== */
+
 /* ==================== Cargo operations ==================== */
 void airport_pop_cargo(struct airport *airport)
 {
@@ -619,91 +1090,93 @@ void ship_unload_freight(struct ship *ship, struct airport *airport)
 }
 /* ==================== /Cargo operations ==================== */
 
-void airport_schedule_transfer(struct airport *airport, double time)
+void airport_schedule_transfer(struct cgl *l, struct airport *airport,
+		double time)
 {
-	airport->sched_cargo_transfer = 1;
-	airport->transfer_time = time + 1;
+	timer_arm(&l->timers, timer_airport(airport - l->airports), time + 1);
 }
-static const double fan_accel[] = {80, 40};
-void cg_step_fan(struct fan *fan, struct ship *ship, double dt)
+static const double fan_accel[] = {FAN_HI_ACCEL, FAN_LOW_ACCEL};
+int cg_step_fan(struct fan *fan, struct ship *ship)
 {
 	if (fan->modifier == 0)
-		return;
-	double dv = fan_accel[fan->power] * fan->modifier * dt;
+		return 0;
+	double a = fan_accel[fan->power] * fan->modifier;
 	switch (fan->dir) {
 	case Down:
-		ship->vy += dv; break;
+		ship->fy += a; break;
 	case Up:
-		ship->vy -= dv; break;
+		ship->fy -= a; break;
 	case Right:
-		ship->vx += dv; break;
+		ship->fx += a; break;
 	case Left:
-		ship->vx -= dv; break;
+		ship->fx -= a; break;
 	}
 	fan->modifier = 0;
+	return 0;
 }
-static const double magn_accel = 50;
-void cg_step_magnet(struct magnet *magnet, struct ship *ship, double dt)
+int cg_step_magnet(struct magnet *magnet, struct ship *ship)
 {
 	if (magnet->modifier == 0)
-		return;
-	double dv = magn_accel * magnet->modifier * dt;
+		return 0;
+	double a = MAGNET_ACCEL * magnet->modifier;
 	switch (magnet->dir) {
 	case Down:
-		ship->vy -= dv; break;
+		ship->fy -= a; break;
 	case Up:
-		ship->vy += dv; break;
+		ship->fy += a; break;
 	case Right:
-		ship->vx -= dv; break;
+		ship->fx -= a; break;
 	case Left:
-		ship->vx += dv; break;
+		ship->fx += a; break;
 	}
 	magnet->modifier = 0;
+	return 0;
 }
 /* ==================== /Object simulators ==================== */
 
-/* ==================== Object animators ==================== */
-/* For static objects, whose animations do not influence the gameplay */
-static const int magnet_anim_order[] = {0, 1, 2, 1};
-static const int fan_anim_order[] = {0, 1, 2};
-static const int airgen_anim_order[] = {0, 1, 2, 3, 4, 5, 6, 7};
-static const int bar_anim_order[][2] = {{0, 1}, {1, 0}};
-static const int key_anim_order[] = {0, 1, 2, 3, 4, 5, 6, 7};
-void animate_fan(struct fan *fan, double time)
+/* ==================== Events ==================== */
+void cg_push_event(struct cgl *l, enum cg_event_type type,
+		struct airport *airport, const struct tile *tile, int arg)
 {
-	int phase = round(time * FAN_ANIM_SPEED);
-	int cur_tex = fan_anim_order[phase % 3];
-	fan->base->tex_x = fan->tex_x + cur_tex * fan->base->w;
+	struct cg_event *e = &l->events[l->nevents % CG_EVENT_RING];
+	e->type = type;
+	e->time = l->time;
+	e->airport = airport;
+	e->tile = tile;
+	e->arg = arg;
+	++l->nevents;
 }
-void animate_magnet(struct magnet *magnet, double time)
+/* Returns the next event after *cursor and advances it, NULL if there are no
+ * new events. Every consumer keeps its own cursor, starting at 0. A consumer
+ * which falls more than CG_EVENT_RING events behind skips the oldest ones. */
+const struct cg_event *cg_next_event(const struct cgl *l, uint32_t *cursor)
 {
-	int phase = round(time * MAGNET_ANIM_SPEED);
-	int cur_tex = magnet_anim_order[phase % 4];
-	magnet->magn->tex_x = magnet->tex_x + cur_tex * magnet->magn->w;
+	if (*cursor == l->nevents)
+		return NULL;
+	if (l->nevents - *cursor > CG_EVENT_RING)
+		*cursor = l->nevents - CG_EVENT_RING;
+	return &l->events[(*cursor)++ % CG_EVENT_RING];
 }
-void animate_airgen(struct airgen *airgen, double time)
+const char *cg_event_name(enum cg_event_type type)
 {
-	int phase = round(time * AIRGEN_ANIM_SPEED);
-	int cur_tex = airgen_anim_order[phase % 8];
-	airgen->base->tex_x = airgen->tex_x + cur_tex * airgen->base->w;
-}
-void animate_bar(struct bar *bar, double time)
-{
-	int phase = round(time * BAR_ANIM_SPEED);
-	int cur_tex = bar_anim_order[0][phase % 2];
-	bar->beg->tex_x = bar->btex_x + cur_tex * BAR_TEX_OFFSET;
-	cur_tex = bar_anim_order[1][phase % 2];
-	bar->end->tex_x = bar->etex_x + cur_tex * BAR_TEX_OFFSET;
-}
-void animate_key(struct airport *airport, double time)
-{
-	if (airport->type != Key)
-		return;
-	int phase = round(time * KEY_ANIM_SPEED);
-	int cur_tex = key_anim_order[phase % 8];
-	airport->cargo[0]->tex_x = KEY_TEX_X + cur_tex * airport->cargo[0]->w;
+	static const char *names[] = {
+		[EvCargoLoaded]   = "cargo loaded",
+		[EvCargoUnloaded] = "cargo unloaded",
+		[EvCargoReturned] = "cargo returned",
+		[EvFuelPickup]    = "fuel picked up",
+		[EvKeyPickup]     = "key obtained",
+		[EvExtraPickup]   = "extra picked up",
+		[EvShipKilled]    = "ship killed",
+		[EvShipRestarted] = "ship restarted",
+		[EvGateOpened]    = "gate opened",
+		[EvLanded]        = "landed",
+		[EvTakeoff]       = "took off",
+		[EvVictory]       = "victory",
+		[EvLost]          = "game over"
+	};
+	return names[type];
 }
-/* ==================== /Object animators ==================== */
+/* ==================== /Events ==================== */
 
 size_t cg_freight_remaining(const struct cgl *l)
 {
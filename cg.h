@@ -29,6 +29,12 @@
 #define ROT_UP 18
 #define AIR_RESISTANCE 0.3
 #define FUEL_SPEED 0.2143
+/* cannon speeds are given in px/s / CANNON_SPEED_SCALE, and a cannon fires
+ * every CANNON_FIRE_PERIOD / fire_rate seconds */
+#define CANNON_SPEED_SCALE 10.0
+#define CANNON_FIRE_PERIOD 20.0
+/* how long the ship is exploding before it is restarted */
+#define KABOOM_TIME 1.0
 enum {
 	BAR_MIN_LEN = 2,
 	GATE_BAR_MIN_LEN = 2,
@@ -36,7 +42,19 @@ enum {
 	GRAVITY = 23,
 	MAX_FUEL = 16,
 	FUEL_BARREL = 6,
-	DEFAULT_LIFE = 5
+	DEFAULT_LIFE = 5,
+	FAN_HI_ACCEL = 80,
+	FAN_LOW_ACCEL = 40,
+	MAGNET_ACCEL = 50,
+	SHIP_MAX_VX = 42,
+	SHIP_MAX_VY = 72,
+	BULLET_SIDE = 4,
+	KABOOM_SPEED = 60,
+	/* a ship step is split in at most this many sub-steps */
+	SHIP_MAX_SUBSTEPS = 16,
+	/* distance a sub-step may cover, as a fraction of the thinnest
+	 * obstacle nearby */
+	SUBSTEP_THICKNESS_DIV = 2
 };
 
 /* Animators */
@@ -50,10 +68,23 @@ enum animations_config {
 	BAR_SPEED_CHANGE_INTERVAL = 4,
 	GATE_BAR_SPEED = 23,
 };
+#define BLINK_SPEED 1.8
+/* The air resistance over a move of dt, kept for the last dt so that a run
+ * of equal steps costs a single exp(). All zeros means empty. */
+struct cg_drag {
+	double dt;
+	/* exp(-AIR_RESISTANCE*dt) and (1 - decay) / AIR_RESISTANCE */
+	double decay, k;
+};
 struct ship {
 	double x, y;
 	double vx, vy;
+	/* acceleration by fans and magnets, sampled by the last collision
+	 * pass */
+	double fx, fy;
 	double rot, rot_speed;
+	/* rot quantized to one of SHIP_NUM_ANGLES orientations, 0 is right */
+	int orient;
 	int engine;
 	int keys[4];
 	/* the size of cargo hold */
@@ -68,15 +99,55 @@ struct ship {
 	int has_turbo;
 	int dead;
 	int life;
+	struct cg_drag drag;
+};
+
+/* Read-only data shared by all simulated level instances. Filled once, then
+ * it may be used concurrently by any number of threads */
+struct cg_shared {
+	collision_map cmap;
+	/* engine thrust for every orientation */
+	double thrust_x[SHIP_NUM_ANGLES],
+	       thrust_y[SHIP_NUM_ANGLES];
+	/* collision mask of every ship sprite - [engine][sprite][row], bit i
+	 * of a row is set when pixel i is solid */
+	uint32_t ship_mask[2][SHIP_NUM_ANGLES][SHIP_H];
 };
 
-void cg_init(struct cgl*);
+int cg_shared_init(struct cg_shared*, const SDL_Surface*);
+void cg_init(struct cgl*, const struct cg_shared*, uint32_t);
+void cg_free(struct cgl*);
 void cg_step(struct cgl*, double);
 void cg_ship_set_engine(struct ship*, int);
+void cg_ship_step(const struct cg_shared*, struct ship*, double);
+size_t cg_substeps(const struct cgl*, const struct ship*, double);
+size_t cg_substeps_at(const struct cgl*, const uint8_t*, double, double,
+		double, double, double, size_t);
+uint8_t *cg_thickness_map(const struct cgl*);
 void cg_ship_rotate(struct ship*, double);
+int cg_collision(const struct cg_shared*, const struct tile*,
+		const struct tile*);
+int cg_collision_rect_point(const struct tile*, const struct tile*);
+double field_modifier(enum dir, const struct tile*, double, double);
+void update_sliding_tile(enum dir, struct tile*, int);
+void update_gate_bar(enum gate_type, struct tile*, int);
+/* cg_move_bar's result */
+enum bar_change {
+	BarFChanged = 1,
+	BarSChanged = 2
+};
+int cg_move_bar(struct bar*, uint32_t*, double);
+double bar_next_change(uint32_t*, double);
+void cg_cannon_shoot(struct bullets*, const struct cannon*, size_t);
+void cg_step_bullets(struct bullets*, double);
+void bullets_separation(size_t, const double*, const double*, double, double,
+		double*);
+void update_bar_tiles(const struct bar*, struct tile*, struct tile*);
+void cg_push_event(struct cgl*, enum cg_event_type, struct airport*,
+		const struct tile*, int);
+const struct cg_event *cg_next_event(const struct cgl*, uint32_t*);
+const char *cg_event_name(enum cg_event_type);
 size_t cg_freight_remaining(const struct cgl*);
 void cg_get_freight_airports(const struct cgl*, struct freight[]);
 
-extern collision_map cmap;
-
 #endif
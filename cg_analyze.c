@@ -0,0 +1,522 @@
+/* cg_analyze.c - headless level difficulty analyzer, flies many randomized
+ * games of a level on all cores and reports where and how ships die
+ * Copyright (C) 2026 FreeCG contributors.
+ *
+ * This file is part of FreeCG.
+ *
+ * FreeCG is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FreeCG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FreeCG. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cg.h"
+#include "gfx.h"
+#include "runner.h"
+#include "mathgeom.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <SDL/SDL.h>
+
+#define TICK (1/60.0)
+
+enum analyze_consts {
+	/* side of a heatmap cell in pixels */
+	HEAT_CELL = 8,
+	/* survival times are histogrammed in bins of 1/LIFE_BIN_RES s */
+	LIFE_BIN_RES = 2,
+	LIFE_BINS = 300 * LIFE_BIN_RES,
+	/* the killers listed in the summary */
+	TOP_TILES = 10
+};
+/* who a tile belongs to, in the order of cgl->tiles */
+enum owner {
+	OwnWall = 0,
+	OwnFan,
+	OwnMagnet,
+	OwnAirgen,
+	OwnCannon,
+	OwnBar,
+	OwnGate,
+	OwnLGate,
+	OwnAirport,
+	NOWNERS
+};
+static const char *owner_names[] = {
+	"wall", "fan", "magnet", "airgen", "cannon", "bar", "gate",
+	"lgate", "airport"
+};
+static const char *collision_type_names[] = {
+	"kaboom", "airgen", "gate", "lgate", "airport", "fan", "magnet"
+};
+enum policy {
+	PolicyRandom = 0,
+	PolicyHover
+};
+
+/* results of any number of games, merged at the end */
+struct stats {
+	size_t runs;
+	size_t victories, losses, timeouts;
+	size_t deaths;
+	size_t by_type[MagnetAction + 1];
+	size_t by_owner[NOWNERS];
+	/* [ntiles] */
+	uint32_t *tile_deaths;
+	/* [hh][hw] */
+	uint32_t *death_heat,
+		 *visit_heat;
+	/* lives ended by death, by length */
+	uint32_t life_hist[LIFE_BINS];
+	double life_sum;
+	/* lives still going when the run timed out */
+	size_t censored;
+	size_t fuel_outs;
+	/* flights between airports, [from][to] */
+	struct route {
+		size_t n;
+		double fuel_used;
+		double min_fuel;
+	} *routes;
+	size_t landings;
+};
+struct analysis {
+	/* read and preprocessed once, every run steps its own copy */
+	const struct cgl *level;
+	const struct cg_shared *shared;
+	enum policy policy;
+	size_t runs;
+	size_t ticks;
+	size_t nchunks;
+	/* taken from a level read once, the same for every instance */
+	size_t ntiles, nairports;
+	size_t hw, hh;
+	struct tile *owner_beg[NOWNERS];
+	size_t owner_nobjs[NOWNERS];
+	/* one per chunk */
+	struct stats *chunk;
+};
+
+void stats_init(struct stats *s, const struct analysis *a)
+{
+	memset(s, 0, sizeof(*s));
+	s->tile_deaths = calloc(a->ntiles, sizeof(*s->tile_deaths));
+	s->death_heat = calloc(a->hw * a->hh, sizeof(*s->death_heat));
+	s->visit_heat = calloc(a->hw * a->hh, sizeof(*s->visit_heat));
+	s->routes = calloc(a->nairports * a->nairports, sizeof(*s->routes));
+	for (size_t i = 0; i < a->nairports * a->nairports; ++i)
+		s->routes[i].min_fuel = MAX_FUEL;
+}
+void stats_free(struct stats *s)
+{
+	free(s->tile_deaths);
+	free(s->death_heat);
+	free(s->visit_heat);
+	free(s->routes);
+}
+void stats_merge(struct stats *d, const struct stats *s,
+		const struct analysis *a)
+{
+	d->runs += s->runs;
+	d->victories += s->victories;
+	d->losses += s->losses;
+	d->timeouts += s->timeouts;
+	d->deaths += s->deaths;
+	for (size_t i = 0; i <= MagnetAction; ++i)
+		d->by_type[i] += s->by_type[i];
+	for (size_t i = 0; i < NOWNERS; ++i)
+		d->by_owner[i] += s->by_owner[i];
+	for (size_t i = 0; i < a->ntiles; ++i)
+		d->tile_deaths[i] += s->tile_deaths[i];
+	for (size_t i = 0; i < a->hw * a->hh; ++i) {
+		d->death_heat[i] += s->death_heat[i];
+		d->visit_heat[i] += s->visit_heat[i];
+	}
+	for (size_t i = 0; i < LIFE_BINS; ++i)
+		d->life_hist[i] += s->life_hist[i];
+	d->life_sum += s->life_sum;
+	d->censored += s->censored;
+	d->fuel_outs += s->fuel_outs;
+	for (size_t i = 0; i < a->nairports * a->nairports; ++i) {
+		struct route *dr = &d->routes[i];
+		const struct route *sr = &s->routes[i];
+		dr->n += sr->n;
+		dr->fuel_used += sr->fuel_used;
+		if (sr->min_fuel < dr->min_fuel)
+			dr->min_fuel = sr->min_fuel;
+	}
+	d->landings += s->landings;
+}
+
+/* Dynamic objects' tiles follow the SOBS tiles in cgl->tiles, one kind after
+ * another, with the same number of tiles for every object of a kind */
+void find_owners(struct analysis *a, const struct cgl *l)
+{
+	struct tile *beg[NOWNERS] = {
+		l->tiles,
+		l->nfans     ? l->fans[0].base         : NULL,
+		l->nmagnets  ? l->magnets[0].base      : NULL,
+		l->nairgens  ? l->airgens[0].base      : NULL,
+		l->ncannons  ? l->cannons[0].beg_base  : NULL,
+		l->nbars     ? l->bars[0].beg          : NULL,
+		l->ngates    ? l->gates[0].base[0]     : NULL,
+		l->nlgates   ? l->lgates[0].base[0]    : NULL,
+		l->nairports ? l->airports[0].base     : NULL
+	};
+	size_t nobjs[NOWNERS] = {
+		1, l->nfans, l->nmagnets, l->nairgens, l->ncannons, l->nbars,
+		l->ngates, l->nlgates, l->nairports
+	};
+	memcpy(a->owner_beg, beg, sizeof(beg));
+	memcpy(a->owner_nobjs, nobjs, sizeof(nobjs));
+}
+/* returns the owner kind and sets *obj to the object's index */
+enum owner tile_owner(const struct analysis *a, size_t t, size_t *obj)
+{
+	size_t beg = 0, end = a->ntiles;
+	enum owner o = OwnWall;
+	for (int k = 0; k < NOWNERS; ++k) {
+		if (!a->owner_beg[k])
+			continue;
+		size_t b = a->owner_beg[k] - a->owner_beg[OwnWall];
+		if (b > t) {
+			end = b;
+			break;
+		}
+		o = k, beg = b;
+	}
+	/* objects of the kind are all as big */
+	*obj = o == OwnWall ? 0 :
+		(t - beg) / ((end - beg) / a->owner_nobjs[o]);
+	return o;
+}
+
+/* random but reproducible input, held for a while like a human would */
+void policy_random(struct ship *s, uint32_t *rng)
+{
+	if (rand_range(rng, 0, 29) == 0)
+		cg_ship_set_engine(s, rand_range(rng, 0, 2) != 0);
+	if (rand_range(rng, 0, 19) == 0)
+		s->rot_speed = rand_range(rng, -1, 1) * 5.5;
+}
+/* keeps the ship roughly level and drifts it around at random - flies much
+ * longer than random input, so it finds the further parts of a level */
+void policy_hover(struct ship *s, uint32_t *rng, double *tilt, double *climb)
+{
+	if (rand_range(rng, 0, 59) == 0) {
+		*tilt = rand_range(rng, -2, 2) * 0.25;
+		*climb = rand_range(rng, -1, 1) * 15.0;
+	}
+	double err = 3/2.0 * M_PI + *tilt - s->rot;
+	normalize_angle(&err);
+	if (err > M_PI)
+		err -= 2*M_PI;
+	s->rot_speed = fmax(-5.5, fmin(5.5, 8 * err));
+	cg_ship_set_engine(s, s->vy > -*climb);
+}
+
+void analyze_run(struct analysis *a, struct stats *st, size_t run)
+{
+	struct cgl *l = cgl_copy(a->level);
+	cg_init(l, a->shared, run + 1);
+	uint32_t input_rng, cursor = 0;
+	rand_seed(&input_rng, ~(uint32_t)run);
+	double tilt = 0, climb = 0, life_start = 0;
+	/* where the ship took off, and with how much fuel */
+	long from = l->hb - l->airports;
+	double takeoff_fuel = l->ship->fuel;
+	int had_fuel = 1;
+	size_t k;
+	for (k = 0; k < a->ticks && l->status == Alive; ++k) {
+		struct ship *s = l->ship;
+		if (a->policy == PolicyHover)
+			policy_hover(s, &input_rng, &tilt, &climb);
+		else
+			policy_random(s, &input_rng);
+		cg_step(l, l->time + TICK);
+		if (!s->dead) {
+			long cx = (long)(s->x + SHIP_W/2) / HEAT_CELL,
+			     cy = (long)(s->y + SHIP_H/2) / HEAT_CELL;
+			if (cx >= 0 && cy >= 0 &&
+					(size_t)cx < a->hw && (size_t)cy < a->hh)
+				++st->visit_heat[cy*a->hw + cx];
+			if (had_fuel && s->fuel <= 0)
+				++st->fuel_outs;
+			had_fuel = s->fuel > 0;
+		}
+		const struct cg_event *ev;
+		while ((ev = cg_next_event(l, &cursor))) {
+			switch (ev->type) {
+			case EvShipKilled: {
+				size_t t = ev->tile - l->tiles, obj;
+				long cx = (long)(s->x + SHIP_W/2) / HEAT_CELL,
+				     cy = (long)(s->y + SHIP_H/2) / HEAT_CELL;
+				double life = ev->time - life_start;
+				size_t bin = life * LIFE_BIN_RES;
+				++st->deaths;
+				++st->by_type[ev->tile->collision_type];
+				++st->by_owner[tile_owner(a, t, &obj)];
+				++st->tile_deaths[t];
+				if (cx >= 0 && cy >= 0 &&
+					(size_t)cx < a->hw && (size_t)cy < a->hh)
+					++st->death_heat[cy*a->hw + cx];
+				++st->life_hist[bin < LIFE_BINS ?
+					bin : LIFE_BINS - 1];
+				st->life_sum += life;
+				break;
+			}
+			case EvShipRestarted:
+				life_start = ev->time;
+				from = l->hb - l->airports;
+				takeoff_fuel = s->fuel;
+				had_fuel = 1;
+				break;
+			case EvTakeoff:
+				from = ev->airport - l->airports;
+				takeoff_fuel = s->fuel;
+				break;
+			case EvLanded: {
+				size_t to = ev->airport - l->airports;
+				struct route *r =
+					&st->routes[from*a->nairports + to];
+				++r->n;
+				r->fuel_used += takeoff_fuel - s->fuel;
+				if (s->fuel < r->min_fuel)
+					r->min_fuel = s->fuel;
+				++st->landings;
+				break;
+			}
+			default:
+				break;
+			}
+		}
+	}
+	++st->runs;
+	switch (l->status) {
+	case Victory:
+		++st->victories; break;
+	case Lost:
+		++st->losses; break;
+	case Alive:
+		++st->timeouts; break;
+	}
+	if (l->status != Lost && !l->ship->dead)
+		++st->censored;
+	cg_free(l);
+	free_cgl(l);
+}
+/* runs a contiguous range of games into the chunk's own stats */
+void analyze_job(void *arg, size_t k)
+{
+	struct analysis *a = arg;
+	size_t beg = a->runs * k / a->nchunks,
+	       end = a->runs * (k + 1) / a->nchunks;
+	for (size_t i = beg; i < end; ++i)
+		analyze_run(a, &a->chunk[k], i);
+}
+
+/* ==================== Output ==================== */
+/* writes a heatmap as a binary PGM, log-scaled so that rare spots show */
+int write_heatmap(const char *path, const uint32_t *heat, size_t w, size_t h)
+{
+	FILE *fp = fopen(path, "wb");
+	if (!fp) {
+		perror(path);
+		return -1;
+	}
+	uint32_t max = 0;
+	for (size_t i = 0; i < w * h; ++i)
+		if (heat[i] > max)
+			max = heat[i];
+	fprintf(fp, "P5\n%zu %zu\n255\n", w, h);
+	for (size_t i = 0; i < w * h; ++i) {
+		double v = max ? log1p(heat[i]) / log1p(max) : 0;
+		fputc((int)(v * 255 + 0.5), fp);
+	}
+	fclose(fp);
+	return 0;
+}
+/* survival time below which the given fraction of lives ended */
+double life_percentile(const struct stats *s, double p)
+{
+	size_t n = 0, total = 0;
+	for (size_t i = 0; i < LIFE_BINS; ++i)
+		total += s->life_hist[i];
+	for (size_t i = 0; i < LIFE_BINS; ++i) {
+		n += s->life_hist[i];
+		if (n >= p * total)
+			return (i + 1) / (double)LIFE_BIN_RES;
+	}
+	return 0;
+}
+void print_summary(const struct analysis *a, const struct stats *s,
+		const struct cgl *l)
+{
+	printf("runs: %zu, won %zu, lost %zu, timed out %zu\n",
+			s->runs, s->victories, s->losses, s->timeouts);
+	printf("deaths: %zu (%.2f per run), fuel ran out %zu times\n",
+			s->deaths, (double)s->deaths / s->runs, s->fuel_outs);
+	if (s->deaths) {
+		printf("survival time: mean %.1f s, p10 %.1f s, "
+				"median %.1f s, p90 %.1f s "
+				"(%zu lives survived the run)\n",
+				s->life_sum / s->deaths,
+				life_percentile(s, 0.1),
+				life_percentile(s, 0.5),
+				life_percentile(s, 0.9), s->censored);
+		printf("deaths by collision type:\n");
+		for (size_t i = 0; i <= MagnetAction; ++i)
+			if (s->by_type[i])
+				printf("  %-8s %6.2f%%\n",
+						collision_type_names[i],
+						100.0 * s->by_type[i] / s->deaths);
+		printf("deaths by object:\n");
+		for (size_t i = 0; i < NOWNERS; ++i)
+			if (s->by_owner[i])
+				printf("  %-8s %6.2f%%\n", owner_names[i],
+						100.0 * s->by_owner[i] / s->deaths);
+	}
+	/* selection of the worst tiles, there are only a few of them */
+	printf("deadliest tiles:\n");
+	uint32_t prev = UINT32_MAX;
+	size_t prev_t = 0;
+	for (int n = 0; n < TOP_TILES; ++n) {
+		size_t best = a->ntiles;
+		for (size_t t = 0; t < a->ntiles; ++t) {
+			uint32_t d = s->tile_deaths[t];
+			if (d == 0 || d > prev || (d == prev && t <= prev_t))
+				continue;
+			if (best == a->ntiles || d > s->tile_deaths[best])
+				best = t;
+		}
+		if (best == a->ntiles)
+			break;
+		size_t obj;
+		enum owner o = tile_owner(a, best, &obj);
+		const struct tile *tile = &l->tiles[best];
+		printf("  %6.2f%%  at (%d, %d) %dx%d, %s", 100.0 *
+				s->tile_deaths[best] / s->deaths,
+				tile->x, tile->y, tile->w, tile->h,
+				owner_names[o]);
+		if (o != OwnWall)
+			printf(" %zu", obj);
+		printf("\n");
+		prev = s->tile_deaths[best], prev_t = best;
+	}
+	if (s->landings) {
+		printf("routes (from -> to: flights, mean fuel used, "
+				"lowest fuel on arrival):\n");
+		for (size_t i = 0; i < a->nairports; ++i)
+			for (size_t j = 0; j < a->nairports; ++j) {
+				const struct route *r =
+					&s->routes[i*a->nairports + j];
+				if (r->n)
+					printf("  %2zu -> %2zu: %6zu, %5.2f, "
+							"%5.2f\n", i, j, r->n,
+							r->fuel_used / r->n,
+							r->min_fuel);
+			}
+	}
+}
+/* ==================== /Output ==================== */
+
+int main(int argc, char *argv[])
+{
+	const char *prog = argv[0],
+	           *prefix = "analyze";
+	enum policy policy = PolicyRandom;
+	for (; argc > 2 && argv[1][0] == '-'; argc -= 2, argv += 2) {
+		if (strcmp(argv[1], "-o") == 0) {
+			prefix = argv[2];
+		} else if (strcmp(argv[1], "-p") == 0 &&
+				strcmp(argv[2], "hover") == 0) {
+			policy = PolicyHover;
+		} else if (strcmp(argv[1], "-p") != 0 ||
+				strcmp(argv[2], "random") != 0) {
+			argc = 0;
+			break;
+		}
+	}
+	if (argc < 2 || argc > 5) {
+		printf("Usage: %s [-p random|hover] [-o prefix] file.cgl "
+		       "[runs [threads [seconds]]]\n"
+		       "  writes prefix_deaths.pgm and prefix_visits.pgm\n",
+				prog);
+		exit(-1);
+	}
+	size_t ncpus = runner_ncpus();
+	size_t runs     = argc > 2 ? (size_t)atoi(argv[2]) : 1000,
+	       nthreads = argc > 3 ? (size_t)atoi(argv[3]) : ncpus,
+	       seconds  = argc > 4 ? (size_t)atoi(argv[4]) : 300;
+	if (runs == 0 || nthreads == 0) {
+		fprintf(stderr, "Wrong number of runs or threads\n");
+		exit(-1);
+	}
+	SDL_Init(0);
+	SDL_Surface *gfx = load_gfx("data/GRAVITY.GFX");
+	if (!gfx) {
+		fprintf(stderr, "read_gfx: %s\n", SDL_GetError());
+		abort();
+	}
+	struct cg_shared *shared = calloc(1, sizeof(*shared));
+	cg_shared_init(shared, gfx);
+	SDL_FreeSurface(gfx);
+	struct cgl *l = read_cgl(argv[1], NULL);
+	if (!l) {
+		fprintf(stderr, "read_cgl: %s\n", SDL_GetError());
+		abort();
+	}
+	cgl_preprocess(l);
+	struct analysis a = {
+		.level = l,
+		.shared = shared,
+		.policy = policy,
+		.runs = runs,
+		.ticks = seconds / TICK,
+		.ntiles = l->ntiles,
+		.nairports = l->nairports,
+		.hw = (l->width * BLOCK_SIZE + HEAT_CELL - 1) / HEAT_CELL,
+		.hh = (l->height * BLOCK_SIZE + HEAT_CELL - 1) / HEAT_CELL
+	};
+	find_owners(&a, l);
+	/* a few chunks per thread to even out the load; every chunk
+	 * collects its own stats, so no locking is needed */
+	a.nchunks = 4 * nthreads < runs ? 4 * nthreads : runs;
+	a.chunk = malloc(a.nchunks * sizeof(*a.chunk));
+	for (size_t k = 0; k < a.nchunks; ++k)
+		stats_init(&a.chunk[k], &a);
+	struct runner *r = runner_new(nthreads);
+	Uint32 start = SDL_GetTicks();
+	runner_run(r, a.nchunks, analyze_job, &a);
+	Uint32 ms = SDL_GetTicks() - start;
+	runner_free(r);
+	struct stats total;
+	stats_init(&total, &a);
+	for (size_t k = 0; k < a.nchunks; ++k) {
+		stats_merge(&total, &a.chunk[k], &a);
+		stats_free(&a.chunk[k]);
+	}
+	free(a.chunk);
+	printf("%s: %zu runs of up to %zu s on %zu thread(s) in %.1f s\n",
+			argv[1], runs, seconds, nthreads, ms / 1000.0);
+	print_summary(&a, &total, l);
+	char path[FILENAME_MAX];
+	snprintf(path, sizeof(path), "%s_deaths.pgm", prefix);
+	write_heatmap(path, total.death_heat, a.hw, a.hh);
+	snprintf(path, sizeof(path), "%s_visits.pgm", prefix);
+	write_heatmap(path, total.visit_heat, a.hw, a.hh);
+	stats_free(&total);
+	free_cgl(l);
+	free(shared);
+	return 0;
+}
@@ -0,0 +1,310 @@
+/* cg_bench.c - headless benchmark stepping many independent level instances
+ * in parallel threads, or many ships of one batched instance
+ * Copyright (C) 2026 FreeCG contributors.
+ *
+ * This file is part of FreeCG.
+ *
+ * FreeCG is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FreeCG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FreeCG. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cg.h"
+#include "gfx.h"
+#include "runner.h"
+#include "batch.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <SDL/SDL.h>
+
+#define TICK (1/60.0)
+
+struct instance {
+	struct cgl *l;
+	uint32_t input_rng;
+};
+struct bench {
+	struct instance *inst;
+	size_t ninst;
+	size_t ticks;
+};
+struct batch_bench {
+	struct cg_batch *b;
+	uint32_t *input_rng;
+	size_t nchunks;
+};
+
+/* random but reproducible input, held for a while like a human would */
+void bench_input(struct instance *in)
+{
+	struct ship *s = in->l->ship;
+	if (rand_range(&in->input_rng, 0, 29) == 0)
+		cg_ship_set_engine(s, rand_range(&in->input_rng, 0, 2) != 0);
+	if (rand_range(&in->input_rng, 0, 19) == 0)
+		s->rot_speed = rand_range(&in->input_rng, -1, 1) * 5.5;
+}
+void bench_job(void *arg, size_t i)
+{
+	struct bench *b = arg;
+	struct instance *in = &b->inst[i];
+	for (size_t k = 0; k < b->ticks; ++k) {
+		bench_input(in);
+		cg_step(in->l, in->l->time + TICK);
+	}
+}
+/* returns the number of simulation steps per second */
+double bench_run(struct bench *b, size_t nthreads)
+{
+	struct runner *r = runner_new(nthreads);
+	Uint32 start = SDL_GetTicks();
+	runner_run(r, b->ninst, bench_job, b);
+	Uint32 ms = SDL_GetTicks() - start;
+	runner_free(r);
+	return (double)b->ninst * b->ticks / (ms ? ms : 1) * 1000;
+}
+
+
+/* ==================== Batch mode ==================== */
+void batch_bench_input(struct cg_batch *b, size_t i, uint32_t *rng)
+{
+	if (rand_range(rng, 0, 29) == 0)
+		cg_batch_set_engine(b, i, rand_range(rng, 0, 2) != 0);
+	if (rand_range(rng, 0, 19) == 0)
+		b->rot_speed[i] = rand_range(rng, -1, 1) * 5.5;
+}
+/* steps one chunk of whole lane groups */
+void batch_bench_job(void *arg, size_t k)
+{
+	struct batch_bench *bb = arg;
+	struct cg_batch *b = bb->b;
+	size_t nblocks = b->np / BATCH_LANES,
+	       beg = nblocks * k / bb->nchunks * BATCH_LANES,
+	       end = nblocks * (k + 1) / bb->nchunks * BATCH_LANES;
+	for (size_t i = beg; i < end && i < b->n; ++i)
+		batch_bench_input(b, i, &bb->input_rng[i]);
+	cg_batch_step_range(b, beg, end, TICK);
+}
+/* returns the number of ship steps per second */
+double batch_bench_run(const struct cgl *l, const struct cg_shared *shared,
+		size_t nships, size_t nthreads, size_t ticks)
+{
+	struct batch_bench bb;
+	bb.b = cg_batch_new(l, shared, nships, 1);
+	bb.input_rng = malloc(nships * sizeof(*bb.input_rng));
+	for (size_t i = 0; i < nships; ++i)
+		rand_seed(&bb.input_rng[i], ~(uint32_t)i);
+	/* a few chunks per thread to even out the load */
+	bb.nchunks = 4 * nthreads;
+	if (bb.nchunks > bb.b->np / BATCH_LANES)
+		bb.nchunks = bb.b->np / BATCH_LANES;
+	struct runner *r = runner_new(nthreads);
+	Uint32 start = SDL_GetTicks();
+	for (size_t k = 0; k < ticks; ++k) {
+		cg_batch_step_shared(bb.b, TICK);
+		runner_run(r, bb.nchunks, batch_bench_job, &bb);
+		bb.b->time += TICK;
+	}
+	Uint32 ms = SDL_GetTicks() - start;
+	runner_free(r);
+	double rate = (double)nships * ticks / (ms ? ms : 1) * 1000;
+	size_t deaths = 0, landings = 0;
+	for (size_t i = 0; i < nships; ++i) {
+		deaths += bb.b->ndeaths[i];
+		landings += bb.b->nlandings[i];
+	}
+	printf("%zu ships, %zu thread(s): %.0f ship steps/s "
+			"(%zu deaths, %zu landings)\n", nships, nthreads,
+			rate, deaths, landings);
+	free(bb.input_rng);
+	cg_batch_free(bb.b);
+	return rate;
+}
+int batch_main(const char *file, const struct cg_shared *shared,
+		size_t nships, size_t nthreads, size_t ticks)
+{
+	struct cgl *l = read_cgl(file, NULL);
+	if (!l) {
+		fprintf(stderr, "read_cgl: %s\n", SDL_GetError());
+		abort();
+	}
+	cgl_preprocess(l);
+	double r1 = batch_bench_run(l, shared, nships, 1, ticks),
+	       rn = batch_bench_run(l, shared, nships, nthreads, ticks);
+	printf("speedup %.2f on %zu threads (%.0f%% efficiency)\n",
+			rn / r1, nthreads, rn / r1 / nthreads * 100);
+	free_cgl(l);
+	return 0;
+}
+/* ==================== /Batch mode ==================== */
+
+/* ==================== Accuracy ==================== */
+/* The ship is flown with a coarse tick and compared against the same flight
+ * with a tick ACC_REF_DIV times finer. Input is held for ACC_HOLD seconds,
+ * which every tick length divides, so all flights get the same controls. */
+#define ACC_HOLD 0.5
+enum {
+	ACC_REF_DIV = 64,
+	/* the length of a flight */
+	ACC_NHOLDS = 60
+};
+/* ticks per hold of the compared tick lengths */
+static const int acc_ticks[] = {30, 15, 8, 4};
+/* the ship at the end of every hold, until it dies */
+struct trace {
+	size_t n;
+	double x[ACC_NHOLDS], y[ACC_NHOLDS];
+};
+/* every flight starts from the untouched level, on a copy of its own */
+void acc_fly(const struct cgl *level, const struct cg_shared *shared,
+		uint32_t seed, int ticks, size_t max_substeps, struct trace *tr)
+{
+	struct cgl *l = cgl_copy(level);
+	struct instance in = {.l = l};
+	cg_init(l, shared, seed);
+	l->max_substeps = max_substeps;
+	rand_seed(&in.input_rng, ~seed);
+	tr->n = 0;
+	for (int h = 0; h < ACC_NHOLDS && !l->ship->dead &&
+			l->status == Alive; ++h) {
+		cg_ship_set_engine(l->ship, rand_range(&in.input_rng, 0, 2) != 0);
+		l->ship->rot_speed = rand_range(&in.input_rng, -1, 1) * 5.5;
+		for (int k = 1; k <= ticks; ++k)
+			cg_step(l, (h + k / (double)ticks) * ACC_HOLD);
+		if (l->ship->dead)
+			break;
+		tr->x[tr->n] = l->ship->x;
+		tr->y[tr->n] = l->ship->y;
+		++tr->n;
+	}
+	cg_free(l);
+	free_cgl(l);
+}
+int accuracy_main(const char *file, const struct cg_shared *shared,
+		size_t ninst)
+{
+	struct cgl *l = read_cgl(file, NULL);
+	if (!l) {
+		fprintf(stderr, "read_cgl: %s\n", SDL_GetError());
+		abort();
+	}
+	cgl_preprocess(l);
+	const size_t nticks = sizeof(acc_ticks) / sizeof(*acc_ticks);
+	struct trace *ref = malloc(ninst * sizeof(*ref)), tr;
+	for (size_t i = 0; i < ninst; ++i)
+		acc_fly(l, shared, i + 1, acc_ticks[0] * ACC_REF_DIV,
+				SHIP_MAX_SUBSTEPS, &ref[i]);
+	printf("reference tick 1/%d s, %.0f s flights with random input\n",
+			(int)(acc_ticks[0] * ACC_REF_DIV / ACC_HOLD),
+			ACC_NHOLDS * ACC_HOLD);
+	printf("%-9s %-9s %10s %10s %12s\n", "tick", "substeps",
+			"mean err", "max err", "fates differ");
+	for (size_t t = 0; t < nticks; ++t)
+		for (size_t sub = 1; sub <= SHIP_MAX_SUBSTEPS;
+				sub += SHIP_MAX_SUBSTEPS - 1) {
+			double sum = 0, worst = 0;
+			size_t nsamples = 0, nfates = 0;
+			for (size_t i = 0; i < ninst; ++i) {
+				acc_fly(l, shared, i + 1, acc_ticks[t], sub, &tr);
+				size_t n = tr.n < ref[i].n ? tr.n : ref[i].n;
+				nfates += tr.n != ref[i].n;
+				for (size_t k = 0; k < n; ++k) {
+					double e = hypot(tr.x[k] - ref[i].x[k],
+							tr.y[k] - ref[i].y[k]);
+					sum += e;
+					worst = e > worst ? e : worst;
+				}
+				nsamples += n;
+			}
+			printf("1/%-7d %-9s %7.3f px %7.3f px %6zu/%zu\n",
+					(int)(acc_ticks[t] / ACC_HOLD),
+					sub == 1 ? "off" : "adaptive",
+					nsamples ? sum / nsamples : 0, worst,
+					nfates, ninst);
+		}
+	free(ref);
+	free_cgl(l);
+	return 0;
+}
+/* ==================== /Accuracy ==================== */
+
+int main(int argc, char *argv[])
+{
+	const char *prog = argv[0];
+	int batch = argc > 1 && strcmp(argv[1], "-b") == 0,
+	    accuracy = argc > 1 && strcmp(argv[1], "-a") == 0;
+	if (batch || accuracy)
+		--argc, ++argv;
+	if (argc < 2 || argc > 5) {
+		printf("Usage: %s [-b|-a] file.cgl [instances [threads [ticks]]]\n"
+		       "  -b  step instances as ships of one batched level\n"
+		       "  -a  compare the ship's motion on coarse ticks with a "
+		       "fine tick\n", prog);
+		exit(-1);
+	}
+	size_t ncpus = runner_ncpus();
+	size_t ninst    = argc > 2 ? (size_t)atoi(argv[2]) : 4 * ncpus,
+	       nthreads = argc > 3 ? (size_t)atoi(argv[3]) : ncpus,
+	       ticks    = argc > 4 ? (size_t)atoi(argv[4]) : 6000;
+	if (ninst == 0 || nthreads == 0) {
+		fprintf(stderr, "Wrong number of instances or threads\n");
+		exit(-1);
+	}
+	SDL_Init(0);
+	SDL_Surface *gfx = load_gfx("data/GRAVITY.GFX");
+	if (!gfx) {
+		fprintf(stderr, "read_gfx: %s\n", SDL_GetError());
+		abort();
+	}
+	struct cg_shared *shared = calloc(1, sizeof(*shared));
+	cg_shared_init(shared, gfx);
+	SDL_FreeSurface(gfx);
+	if (batch)
+		return batch_main(argv[1], shared, ninst, nthreads, ticks);
+	if (accuracy)
+		return accuracy_main(argv[1], shared, ninst);
+	struct bench b = {
+		.ninst = ninst,
+		.ticks = ticks
+	};
+	b.inst = calloc(ninst, sizeof(*b.inst));
+	/* run the same workload twice - on one thread and on all of them */
+	double rate[2];
+	size_t threads[2] = {1, nthreads};
+	for (int k = 0; k < 2; ++k) {
+		for (size_t i = 0; i < ninst; ++i) {
+			struct cgl *l = read_cgl(argv[1], NULL);
+			if (!l) {
+				fprintf(stderr, "read_cgl: %s\n", SDL_GetError());
+				abort();
+			}
+			cgl_preprocess(l);
+			cg_init(l, shared, i + 1);
+			b.inst[i].l = l;
+			rand_seed(&b.inst[i].input_rng, ~(uint32_t)i);
+		}
+		rate[k] = bench_run(&b, threads[k]);
+		printf("%zu instances, %zu thread(s): %.0f steps/s\n",
+				ninst, threads[k], rate[k]);
+		for (size_t i = 0; i < ninst; ++i) {
+			cg_free(b.inst[i].l);
+			free_cgl(b.inst[i].l);
+		}
+	}
+	printf("speedup %.2f on %zu threads (%.0f%% efficiency)\n",
+			rate[1] / rate[0], nthreads,
+			rate[1] / rate[0] / nthreads * 100);
+	free(b.inst);
+	free(shared);
+	return 0;
+}
@@ -0,0 +1,687 @@
+/* cg_route.c - plans flights between the airports of a level by searching
+ * over the ship's real dynamics, and checks the plans in the simulator
+ * Copyright (C) 2026 FreeCG contributors.
+ *
+ * This file is part of FreeCG.
+ *
+ * FreeCG is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FreeCG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FreeCG. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cg.h"
+#include "gfx.h"
+#include "runner.h"
+#include "mathgeom.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <SDL/SDL.h>
+
+#define TICK (1/60.0)
+/* rotation speed of the ship when a rotation key is held */
+#define ROT_INPUT 5.5
+/* heuristic: assumed average speed along the shortest path, px/s */
+#define HEUR_SPEED 60.0
+/* weight of the heuristic - above 1 trades optimality for speed */
+#define HEUR_WEIGHT 1.5
+
+enum route_consts {
+	/* ticks one input is held for, a step of the lattice */
+	ACTION_TICKS = 6,
+	/* engine off/on times rotation left/none/right */
+	NACTIONS = 6,
+	/* side of a heuristic grid cell in pixels */
+	HCELL = 4,
+	/* lattice resolution of the memoized states */
+	KEY_POS = 2,
+	KEY_VEL = 6
+};
+
+/* ==================== Level model ==================== */
+/* Everything the planner knows about a level. It is read only during
+ * planning, so all searches share it.
+ *
+ * The planner avoids everything that would change the ship's motion in a way
+ * cg_ship_step() does not model: fans, magnets, airgens and gate switches are
+ * treated as walls, randomly moving bars block their whole channel and so do
+ * the tracks of firing cannons' bullets. Thus a planned flight is flown the
+ * same way by cg_step(). */
+struct planner {
+	const struct cgl *l;
+	const struct cg_shared *shared;
+	/* [ntiles] - tiles replaced by the channels below */
+	uint8_t *skip;
+	size_t nchannels;
+	struct tile *channels;
+	double fuel;
+	size_t max_nodes;
+	/* heuristic grid, [hh][hw] */
+	size_t hw, hh;
+	uint8_t *blocked;
+	/* per target airport, distance in px to its landing box */
+	double **dist;
+};
+/* a flight found between two airports */
+struct step {
+	uint16_t ticks;
+	int8_t engine,
+	       rot;
+};
+struct route {
+	size_t from, to;
+	/* where the ship stands on the first airport */
+	double start_x;
+	int found;
+	int verified;
+	size_t nexpanded;
+	double time;
+	double fuel_used;
+	size_t nsteps;
+	struct step *steps;
+};
+
+int landing_ok(const struct ship *s, const struct tile *stile,
+		const struct airport *ap)
+{
+	struct tile allowed;
+	rect_to_tile(&ap->lbbox, &allowed);
+	/* the same rule as in cg_handle_collision_airport() */
+	return s->orient == ROT_UP &&
+		cg_collision_rect_point(stile, &allowed) &&
+		fabs(s->vx) < s->max_vx && fabs(s->vy) < s->max_vy;
+}
+enum touch {
+	TouchNone = 0,
+	TouchKill,
+	TouchAirport
+};
+/* Side effect free version of cg_handle_collisions(). Returns TouchAirport
+ * and the airport if the ship touches an airport the right way. */
+enum touch route_collide(const struct planner *p, const struct ship *s,
+		const struct airport **ap)
+{
+	const struct cgl *l = p->l;
+	struct tile stile;
+	ship_to_tile(s, &stile);
+	*ap = NULL;
+	size_t x = max(0, s->x / BLOCK_SIZE),
+	       y = max(0, s->y / BLOCK_SIZE);
+	int end_x = min(s->x + SHIP_W, l->width * BLOCK_SIZE),
+	    end_y = min(s->y + SHIP_H, l->height * BLOCK_SIZE);
+	for (size_t j = y; (signed)j*BLOCK_SIZE < end_y; ++j)
+		for (size_t i = x; (signed)i*BLOCK_SIZE < end_x; ++i) {
+			block blk = l->blocks[j][i];
+			for (size_t k = 0; blk[k] != NULL; ++k) {
+				const struct tile *t = blk[k];
+				if (p->skip[t - l->tiles] ||
+				    !cg_collision(p->shared, &stile, t))
+					continue;
+				if (t->collision_type != AirportAction ||
+				    !landing_ok(s, &stile, t->data))
+					return TouchKill;
+				*ap = t->data;
+			}
+		}
+	for (size_t k = 0; k < p->nchannels; ++k)
+		if (cg_collision(p->shared, &stile, &p->channels[k]))
+			return TouchKill;
+	return *ap ? TouchAirport : TouchNone;
+}
+/* lands the ship on the airport like cg_restart_ship() does */
+void route_place_ship(struct ship *s, const struct airport *ap, double x,
+		double fuel)
+{
+	s->vx = s->vy = 0;
+	s->rot_speed = 0;
+	s->x = x;
+	s->y = ap->base->y - 20;
+	s->engine = 0;
+	s->rot = 3/2.0 * M_PI;
+	s->orient = ROT_UP;
+	s->airport = (struct airport*)ap;
+	s->fuel = fuel;
+	s->dead = 0;
+}
+/* The middle of the airport may be taken by cargo, find the nearest spot
+ * where the ship can stand */
+double route_start_x(const struct planner *p, const struct airport *ap)
+{
+	struct ship s;
+	memset(&s, 0, sizeof(s));
+	s.max_vx = SHIP_MAX_VX;
+	s.max_vy = SHIP_MAX_VY;
+	int mid = ap->base->x + (ap->base->w - SHIP_W)/2;
+	for (int d = 0; d < (int)ap->lbbox.w; ++d)
+		for (int sign = -1; sign <= 1; sign += 2) {
+			const struct airport *touched;
+			route_place_ship(&s, ap, mid + sign*d, 0);
+			if (route_collide(p, &s, &touched) != TouchKill)
+				return s.x;
+		}
+	return mid;
+}
+
+int cell_blocked(const struct planner *p, int cx, int cy)
+{
+	const struct cgl *l = p->l;
+	size_t bx = cx / BLOCK_SIZE, by = cy / BLOCK_SIZE;
+	if (bx >= l->width || by >= l->height)
+		return 1;
+	block blk = l->blocks[by][bx];
+	for (size_t k = 0; blk[k] != NULL; ++k) {
+		const struct tile *t = blk[k];
+		if (p->skip[t - l->tiles] || t->collision_test == NoCollision ||
+		    cx < t->x || cx >= t->x + t->w ||
+		    cy < t->y || cy >= t->y + t->h)
+			continue;
+		if (t->collision_test != Bitmap ||
+		    p->shared->cmap[t->tex_y + cy - t->y][t->tex_x + cx - t->x])
+			return 1;
+	}
+	for (size_t k = 0; k < p->nchannels; ++k) {
+		const struct tile *t = &p->channels[k];
+		if (cx >= t->x && cx < t->x + t->w &&
+		    cy >= t->y && cy < t->y + t->h)
+			return 1;
+	}
+	return 0;
+}
+void planner_init(struct planner *p, const struct cgl *l,
+		const struct cg_shared *shared)
+{
+	p->l = l;
+	p->shared = shared;
+	p->skip = calloc(l->ntiles, sizeof(*p->skip));
+	p->channels = calloc(l->nbars + l->ncannons, sizeof(*p->channels));
+	for (size_t i = 0; i < l->nbars; ++i) {
+		const struct bar *b = &l->bars[i];
+		struct tile *c = &p->channels[i];
+		p->skip[b->fbar - l->tiles] = p->skip[b->sbar - l->tiles] = 1;
+		c->x = min(b->beg->x, b->end->x);
+		c->y = min(b->beg->y, b->end->y);
+		c->w = max(b->beg->x + b->beg->w, b->end->x + b->end->w) - c->x;
+		c->h = max(b->beg->y + b->beg->h, b->end->y + b->end->h) - c->y;
+		c->collision_test = Rect;
+		c->collision_type = Kaboom;
+	}
+	p->nchannels = l->nbars;
+	for (size_t i = 0; i < l->ncannons; ++i) {
+		const struct cannon *cn = &l->cannons[i];
+		if (cn->fire_rate <= 0 || (!cn->speed_x && !cn->speed_y))
+			continue;
+		struct tile *c = &p->channels[p->nchannels++];
+		c->x = min(cn->beg.x, cn->end.x) - BULLET_SIDE;
+		c->y = min(cn->beg.y, cn->end.y) - BULLET_SIDE;
+		c->w = abs(cn->end.x - cn->beg.x) + 2*BULLET_SIDE;
+		c->h = abs(cn->end.y - cn->beg.y) + 2*BULLET_SIDE;
+		c->collision_test = Rect;
+		c->collision_type = Kaboom;
+	}
+	p->hw = l->width * BLOCK_SIZE / HCELL;
+	p->hh = l->height * BLOCK_SIZE / HCELL;
+	p->blocked = malloc(p->hw * p->hh);
+	for (size_t j = 0; j < p->hh; ++j)
+		for (size_t i = 0; i < p->hw; ++i)
+			p->blocked[j*p->hw + i] = cell_blocked(p,
+					i*HCELL + HCELL/2, j*HCELL + HCELL/2);
+	p->dist = calloc(l->nairports, sizeof(*p->dist));
+}
+void planner_free(struct planner *p)
+{
+	for (size_t i = 0; i < p->l->nairports; ++i)
+		free(p->dist[i]);
+	free(p->dist);
+	free(p->blocked);
+	free(p->channels);
+	free(p->skip);
+}
+/* ==================== /Level model ==================== */
+
+/* ==================== Search ==================== */
+struct heap {
+	size_t n, cap;
+	struct heap_item {
+		double key;
+		uint32_t val;
+	} *items;
+};
+void heap_push(struct heap *h, double key, uint32_t val)
+{
+	if (h->n == h->cap) {
+		h->cap = h->cap ? 2*h->cap : 1024;
+		h->items = realloc(h->items, h->cap * sizeof(*h->items));
+	}
+	size_t i = h->n++;
+	while (i > 0 && h->items[(i-1)/2].key > key) {
+		h->items[i] = h->items[(i-1)/2];
+		i = (i-1)/2;
+	}
+	h->items[i].key = key;
+	h->items[i].val = val;
+}
+uint32_t heap_pop(struct heap *h)
+{
+	uint32_t top = h->items[0].val;
+	struct heap_item last = h->items[--h->n];
+	size_t i = 0;
+	for (;;) {
+		size_t c = 2*i + 1;
+		if (c >= h->n)
+			break;
+		if (c + 1 < h->n && h->items[c+1].key < h->items[c].key)
+			++c;
+		if (h->items[c].key >= last.key)
+			break;
+		h->items[i] = h->items[c];
+		i = c;
+	}
+	if (h->n)
+		h->items[i] = last;
+	return top;
+}
+
+/* Shortest distance from every cell of the heuristic grid to the landing box
+ * of the airport, ignoring dynamics. One per target, shared by all searches
+ * which go there. */
+void dist_job(void *arg, size_t to)
+{
+	struct planner *p = arg;
+	const struct airport *ap = &p->l->airports[to];
+	size_t n = p->hw * p->hh;
+	double *d = malloc(n * sizeof(*d));
+	for (size_t i = 0; i < n; ++i)
+		d[i] = DBL_MAX;
+	struct heap h = {0, 0, NULL};
+	size_t gx = (ap->lbbox.x + ap->lbbox.w/2) / HCELL,
+	       gy = (ap->lbbox.y + ap->lbbox.h/2) / HCELL;
+	if (gx < p->hw && gy < p->hh) {
+		d[gy*p->hw + gx] = 0;
+		heap_push(&h, 0, gy*p->hw + gx);
+	}
+	while (h.n) {
+		double dc = h.items[0].key;
+		uint32_t c = heap_pop(&h);
+		if (dc > d[c])
+			continue;
+		int cx = c % p->hw, cy = c / p->hw;
+		for (int dy = -1; dy <= 1; ++dy)
+			for (int dx = -1; dx <= 1; ++dx) {
+				int nx = cx + dx, ny = cy + dy;
+				if ((dx == 0 && dy == 0) || nx < 0 || ny < 0 ||
+				    (size_t)nx >= p->hw || (size_t)ny >= p->hh)
+					continue;
+				uint32_t nc = ny*p->hw + nx;
+				double nd = dc + HCELL * (dx && dy ? sqrt(2) : 1);
+				if (p->blocked[nc] || nd >= d[nc])
+					continue;
+				d[nc] = nd;
+				heap_push(&h, nd, nc);
+			}
+	}
+	free(h.items);
+	p->dist[to] = d;
+}
+double heuristic(const struct planner *p, const double *dist,
+		const struct ship *s)
+{
+	long cx = (long)(s->x + SHIP_W/2) / HCELL,
+	     cy = (long)(s->y + SHIP_H/2) / HCELL;
+	if (cx < 0 || cy < 0 || (size_t)cx >= p->hw || (size_t)cy >= p->hh)
+		return DBL_MAX;
+	double d = dist[cy*p->hw + cx];
+	return d == DBL_MAX ? DBL_MAX : d / HEUR_SPEED;
+}
+
+/* a lattice node - the full state of the ship model after an action */
+struct rnode {
+	double x, y, vx, vy, rot, fuel, time;
+	int32_t parent;
+	int16_t airport, pending;
+	uint8_t orient, action, nticks;
+};
+/* memoized lattice states, open addressing */
+struct memo {
+	size_t n, cap;
+	uint64_t *keys;
+};
+uint64_t state_key(const struct rnode *n)
+{
+	uint64_t k = (uint64_t)(uint16_t)(int)floor(n->x / KEY_POS);
+	k = k << 16 | (uint16_t)(int)floor(n->y / KEY_POS);
+	k = k << 10 | ((int)floor(n->vx / KEY_VEL) & 0x3ff);
+	k = k << 10 | ((int)floor(n->vy / KEY_VEL) & 0x3ff);
+	k = k << 5 | n->orient;
+	k = k << 1 | (n->airport >= 0);
+	/* 0 marks empty slots */
+	return k | 1ull << 63;
+}
+/* returns 1 if the key was not seen before */
+int memo_insert(struct memo *m, uint64_t key)
+{
+	if (2 * (m->n + 1) > m->cap) {
+		struct memo g = {0, m->cap ? 2*m->cap : 1 << 16, NULL};
+		g.keys = calloc(g.cap, sizeof(*g.keys));
+		for (size_t i = 0; i < m->cap; ++i)
+			if (m->keys[i])
+				memo_insert(&g, m->keys[i]);
+		free(m->keys);
+		*m = g;
+	}
+	size_t i = (key * 0x9e3779b97f4a7c15ull) >> 20 & (m->cap - 1);
+	for (; m->keys[i]; i = (i + 1) & (m->cap - 1))
+		if (m->keys[i] == key)
+			return 0;
+	m->keys[i] = key;
+	++m->n;
+	return 1;
+}
+
+void node_to_ship(const struct rnode *n, const struct cgl *l, struct ship *s)
+{
+	memset(s, 0, sizeof(*s));
+	s->x = n->x, s->y = n->y;
+	s->vx = n->vx, s->vy = n->vy;
+	s->rot = n->rot;
+	s->orient = n->orient;
+	s->fuel = n->fuel;
+	s->airport = n->airport >= 0 ? &l->airports[n->airport] : NULL;
+	s->max_vx = SHIP_MAX_VX;
+	s->max_vy = SHIP_MAX_VY;
+}
+/* Applies one input to the ship for one tick, as cg_step() would, with the
+ * same sub-steps and a collision test after each of them. Returns what the
+ * ship touched. */
+enum touch model_tick(const struct planner *p, struct ship *s,
+		int16_t *pending, double *time, int engine, int rot,
+		const struct airport **ap)
+{
+	/* landing is done by cg_step_airport() in the step after the touch */
+	if (*pending >= 0) {
+		const struct airport *ap = &p->l->airports[*pending];
+		s->y = ap->base->y - 20;
+		s->vx = s->vy = 0;
+		s->airport = (struct airport*)ap;
+		*pending = -1;
+	}
+	cg_ship_set_engine(s, engine);
+	s->rot_speed = rot * ROT_INPUT;
+	double t = *time + TICK,
+	       dt = t - *time;
+	enum touch touch = TouchNone;
+	size_t n = cg_substeps(p->l, s, dt);
+	for (size_t k = 0; k < n && touch == TouchNone; ++k) {
+		cg_ship_step(p->shared, s, dt / n);
+		touch = route_collide(p, s, ap);
+	}
+	*time = t;
+	return touch;
+}
+
+/* Weighted A* over the lattice, the cost is the flight time */
+void route_search(const struct planner *p, struct route *r)
+{
+	const struct cgl *l = p->l;
+	const double *dist = p->dist[r->to];
+	size_t nnodes = 0, cap = 4096;
+	struct rnode *nodes = malloc(cap * sizeof(*nodes));
+	struct heap open = {0, 0, NULL};
+	struct memo memo = {0, 0, NULL};
+	struct ship s;
+	memset(&s, 0, sizeof(s));
+	r->start_x = route_start_x(p, &l->airports[r->from]);
+	route_place_ship(&s, &l->airports[r->from], r->start_x, p->fuel);
+	struct rnode *root = &nodes[nnodes++];
+	*root = (struct rnode){
+		.x = s.x, .y = s.y, .rot = s.rot, .fuel = s.fuel,
+		.parent = -1, .airport = r->from, .pending = -1,
+		.orient = s.orient
+	};
+	memo_insert(&memo, state_key(root));
+	heap_push(&open, 0, 0);
+	int32_t goal = -1;
+	while (open.n && goal < 0 && r->nexpanded < p->max_nodes) {
+		uint32_t cur = heap_pop(&open);
+		++r->nexpanded;
+		for (int a = 0; a < NACTIONS && goal < 0; ++a) {
+			int engine = a / 3, rot = a % 3 - 1;
+			struct rnode n = nodes[cur];
+			node_to_ship(&n, l, &s);
+			int alive = 1, k;
+			for (k = 0; k < ACTION_TICKS; ++k) {
+				const struct airport *ap;
+				enum touch t = model_tick(p, &s, &n.pending,
+						&n.time, engine, rot, &ap);
+				if (t == TouchKill) {
+					alive = 0;
+					break;
+				}
+				if (t == TouchAirport) {
+					size_t ai = ap - l->airports;
+					if (ai == r->to) {
+						++k;
+						goal = nnodes;
+						break;
+					} else if (ai == r->from) {
+						n.pending = ai;
+					} else {
+						alive = 0;
+						break;
+					}
+				}
+			}
+			if (!alive)
+				continue;
+			n.x = s.x, n.y = s.y;
+			n.vx = s.vx, n.vy = s.vy;
+			n.rot = s.rot, n.orient = s.orient;
+			n.fuel = s.fuel;
+			n.airport = s.airport ? s.airport - l->airports : -1;
+			n.parent = cur;
+			n.action = a;
+			n.nticks = k;
+			double h = heuristic(p, dist, &s);
+			if (goal < 0 && (h == DBL_MAX || !memo_insert(&memo,
+							state_key(&n))))
+				continue;
+			if (nnodes == cap) {
+				cap *= 2;
+				nodes = realloc(nodes, cap * sizeof(*nodes));
+			}
+			nodes[nnodes] = n;
+			if (goal < 0)
+				heap_push(&open, n.time + HEUR_WEIGHT * h,
+						nnodes);
+			++nnodes;
+		}
+	}
+	if (goal >= 0) {
+		r->found = 1;
+		r->time = nodes[goal].time;
+		r->fuel_used = p->fuel - nodes[goal].fuel;
+		for (int32_t i = goal; nodes[i].parent >= 0; i = nodes[i].parent)
+			++r->nsteps;
+		r->steps = malloc(r->nsteps * sizeof(*r->steps));
+		size_t k = r->nsteps;
+		for (int32_t i = goal; nodes[i].parent >= 0; i = nodes[i].parent)
+			r->steps[--k] = (struct step){
+				.ticks = nodes[i].nticks,
+				.engine = nodes[i].action / 3,
+				.rot = nodes[i].action % 3 - 1
+			};
+	}
+	free(memo.keys);
+	free(open.items);
+	free(nodes);
+}
+/* ==================== /Search ==================== */
+
+/* ==================== Replay ==================== */
+/* Flies the route in the real simulator, on a fresh copy of the level. The
+ * route is good if the ship lands on the target before it dies. */
+int route_verify(const char *file, const struct cg_shared *shared,
+		const struct route *r, double fuel)
+{
+	struct cgl *l = read_cgl(file, NULL);
+	if (!l)
+		return 0;
+	cgl_preprocess(l);
+	cg_init(l, shared, 1);
+	route_place_ship(l->ship, &l->airports[r->from], r->start_x, fuel);
+	uint32_t cursor = 0;
+	int landed = 0, killed = 0;
+	/* the landing event comes one step after the touch */
+	for (size_t i = 0; i <= r->nsteps && !landed && !killed; ++i) {
+		struct step st = i < r->nsteps ? r->steps[i] :
+			(struct step){2, 0, 0};
+		for (int k = 0; k < st.ticks && !landed && !killed; ++k) {
+			cg_ship_set_engine(l->ship, st.engine);
+			l->ship->rot_speed = st.rot * ROT_INPUT;
+			cg_step(l, l->time + TICK);
+			const struct cg_event *ev;
+			while ((ev = cg_next_event(l, &cursor))) {
+				if (ev->type == EvShipKilled)
+					killed = 1;
+				else if (ev->type == EvLanded &&
+					 ev->airport == &l->airports[r->to])
+					landed = 1;
+			}
+		}
+	}
+	cg_free(l);
+	free_cgl(l);
+	return landed && !killed;
+}
+/* ==================== /Replay ==================== */
+
+struct route_run {
+	struct planner *p;
+	const char *file;
+	struct route *routes;
+};
+void route_job(void *arg, size_t i)
+{
+	struct route_run *rr = arg;
+	struct route *r = &rr->routes[i];
+	route_search(rr->p, r);
+	if (r->found)
+		r->verified = route_verify(rr->file, rr->p->shared, r,
+				rr->p->fuel);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *prog = argv[0],
+	           *out = NULL;
+	double fuel = MAX_FUEL;
+	size_t max_nodes = 200000;
+	for (; argc > 2 && argv[1][0] == '-'; argc -= 2, argv += 2) {
+		if (strcmp(argv[1], "-o") == 0) {
+			out = argv[2];
+		} else if (strcmp(argv[1], "-f") == 0) {
+			fuel = atof(argv[2]);
+		} else if (strcmp(argv[1], "-n") == 0) {
+			max_nodes = atoi(argv[2]);
+		} else {
+			argc = 0;
+			break;
+		}
+	}
+	if (argc < 2 || argc > 5) {
+		printf("Usage: %s [-f fuel] [-n max_nodes] [-o routes.txt] "
+		       "file.cgl [from to [threads]]\n"
+		       "  plans flights between all airports if none given\n",
+				prog);
+		exit(-1);
+	}
+	size_t nthreads = argc == 3 || argc == 5 ?
+		(size_t)atoi(argv[argc - 1]) : runner_ncpus();
+	if (nthreads == 0) {
+		fprintf(stderr, "Wrong number of threads\n");
+		exit(-1);
+	}
+	SDL_Init(0);
+	SDL_Surface *gfx = load_gfx("data/GRAVITY.GFX");
+	if (!gfx) {
+		fprintf(stderr, "read_gfx: %s\n", SDL_GetError());
+		abort();
+	}
+	struct cg_shared *shared = calloc(1, sizeof(*shared));
+	cg_shared_init(shared, gfx);
+	SDL_FreeSurface(gfx);
+	struct cgl *l = read_cgl(argv[1], NULL);
+	if (!l) {
+		fprintf(stderr, "read_cgl: %s\n", SDL_GetError());
+		abort();
+	}
+	cgl_preprocess(l);
+	struct planner p;
+	planner_init(&p, l, shared);
+	p.fuel = fuel;
+	p.max_nodes = max_nodes;
+	/* all ordered pairs, or just the one asked for */
+	size_t nroutes = 0;
+	struct route *routes = calloc(l->nairports * l->nairports,
+			sizeof(*routes));
+	for (size_t i = 0; i < l->nairports; ++i)
+		for (size_t j = 0; j < l->nairports; ++j) {
+			if (i == j || (argc >= 4 && ((size_t)atoi(argv[2]) != i ||
+						     (size_t)atoi(argv[3]) != j)))
+				continue;
+			routes[nroutes].from = i;
+			routes[nroutes].to = j;
+			++nroutes;
+		}
+	struct runner *r = runner_new(nthreads);
+	Uint32 start = SDL_GetTicks();
+	runner_run(r, l->nairports, dist_job, &p);
+	struct route_run rr = {&p, argv[1], routes};
+	runner_run(r, nroutes, route_job, &rr);
+	Uint32 ms = SDL_GetTicks() - start;
+	runner_free(r);
+	printf("%s: %zu routes planned on %zu thread(s) in %.1f s, "
+			"fuel %.1f\n", argv[1], nroutes, nthreads,
+			ms / 1000.0, fuel);
+	FILE *fp = out ? fopen(out, "w") : NULL;
+	if (out && !fp)
+		perror(out);
+	for (size_t i = 0; i < nroutes; ++i) {
+		const struct route *rt = &routes[i];
+		printf("  %2zu -> %2zu: ", rt->from, rt->to);
+		if (rt->found)
+			printf("%5.2f s, fuel %5.2f, %s", rt->time,
+					rt->fuel_used, rt->verified ?
+					"replayed" : "REPLAY FAILED");
+		else
+			printf("no route");
+		printf(" (%zu nodes expanded)\n", rt->nexpanded);
+		if (!fp || !rt->found)
+			continue;
+		/* one input per line: ticks held, engine, rotation */
+		fprintf(fp, "route %zu %zu %.0f %zu\n", rt->from, rt->to,
+				rt->start_x, rt->nsteps);
+		for (size_t k = 0; k < rt->nsteps; ++k)
+			fprintf(fp, "%d %d %d\n", rt->steps[k].ticks,
+					rt->steps[k].engine, rt->steps[k].rot);
+	}
+	if (fp)
+		fclose(fp);
+	for (size_t i = 0; i < nroutes; ++i)
+		free(routes[i].steps);
+	free(routes);
+	planner_free(&p);
+	free_cgl(l);
+	free(shared);
+	return 0;
+}
@@ -0,0 +1,165 @@
+/* cg_thumb.c - renders pictures of levels without a display
+ * Copyright (C) 2026 FreeCG contributors.
+ *
+ * This file is part of FreeCG.
+ *
+ * FreeCG is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FreeCG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FreeCG. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cg.h"
+#include "gfx.h"
+#include "runner.h"
+#include "swrender.h"
+#include "pngout.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <SDL/SDL.h>
+
+#define TICK (1/60.0)
+
+enum thumb_consts {
+	/* width of a picture of the whole level when no zoom is given */
+	THUMB_WIDTH = 256
+};
+
+struct thumbs {
+	char **files;
+	const char *dir;
+	const struct cg_shared *shared;
+	const SDL_Surface *tileset;
+	/* simulation time of the picture */
+	double time;
+	/* 0 to fit the level in THUMB_WIDTH */
+	double zoom;
+	/* 0 for the whole level */
+	int w, h;
+	/* the camera, at the level's center if not given */
+	int camera;
+	double cx, cy;
+	/* the number of pictures which could not be written */
+	SDL_mutex *lock;
+	size_t nfailed;
+};
+
+/* out/LEVEL.png for some/path/LEVEL.CGL */
+void thumb_path(char *buf, size_t size, const char *dir, const char *file)
+{
+	const char *base = strrchr(file, '/');
+	base = base ? base + 1 : file;
+	const char *dot = strrchr(base, '.');
+	int len = dot ? dot - base : (int)strlen(base);
+	snprintf(buf, size, "%s/%.*s.png", dir, len, base);
+}
+void thumb_job(void *arg, size_t k)
+{
+	struct thumbs *th = arg;
+	const char *file = th->files[k];
+	struct cgl *l = read_cgl(file, NULL);
+	int err = -1;
+	if (!l) {
+		fprintf(stderr, "%s: %s\n", file, SDL_GetError());
+		goto out;
+	}
+	cgl_preprocess(l);
+	cg_init(l, th->shared, 1);
+	while (l->time + TICK / 2 < th->time)
+		cg_step(l, l->time + TICK);
+	double lw = l->width * BLOCK_SIZE,
+	       lh = l->height * BLOCK_SIZE,
+	       zoom = th->zoom > 0 ? th->zoom : THUMB_WIDTH / lw;
+	int w = th->w ? th->w : ceil(lw * zoom),
+	    h = th->h ? th->h : ceil(lh * zoom);
+	struct sw_view v = {
+		.x = (th->camera ? th->cx : lw / 2) - w / zoom / 2,
+		.y = (th->camera ? th->cy : lh / 2) - h / zoom / 2,
+		.scale = zoom
+	};
+	struct sw_image im;
+	sw_image_init(&im, w, h);
+	sw_render(l, th->tileset, &v, &im);
+	char path[1024];
+	thumb_path(path, sizeof(path), th->dir, file);
+	err = png_write(path, im.px, w, h);
+	if (!err)
+		printf("%s: %dx%d at %.2fs\n", path, w, h, l->time);
+	sw_image_free(&im);
+	cg_free(l);
+	free_cgl(l);
+out:
+	if (err) {
+		SDL_mutexP(th->lock);
+		th->nfailed++;
+		SDL_mutexV(th->lock);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	const char *prog = argv[0];
+	struct thumbs th = {
+		.dir = "."
+	};
+	size_t nthreads = runner_ncpus();
+	for (; argc > 2 && argv[1][0] == '-'; argc -= 2, argv += 2) {
+		if (strcmp(argv[1], "-o") == 0) {
+			th.dir = argv[2];
+		} else if (strcmp(argv[1], "-t") == 0) {
+			th.time = atof(argv[2]);
+		} else if (strcmp(argv[1], "-z") == 0) {
+			th.zoom = atof(argv[2]);
+		} else if (strcmp(argv[1], "-s") == 0 &&
+				sscanf(argv[2], "%dx%d", &th.w, &th.h) == 2 &&
+				th.w > 0 && th.h > 0) {
+			continue;
+		} else if (strcmp(argv[1], "-c") == 0 &&
+				sscanf(argv[2], "%lf,%lf", &th.cx, &th.cy) == 2) {
+			th.camera = 1;
+		} else if (strcmp(argv[1], "-j") == 0 && atoi(argv[2]) > 0) {
+			nthreads = atoi(argv[2]);
+		} else {
+			argc = 0;
+			break;
+		}
+	}
+	if (argc < 2) {
+		printf("Usage: %s [-t seconds] [-z zoom] [-s WxH] [-c x,y] "
+		       "[-o dir] [-j threads] file.cgl...\n"
+		       "  writes dir/FILE.png for every level, by default "
+		       "the whole level %d pixels wide\n", prog, THUMB_WIDTH);
+		exit(-1);
+	}
+	SDL_Init(0);
+	SDL_Surface *gfx = load_gfx("data/GRAVITY.GFX");
+	if (!gfx) {
+		fprintf(stderr, "read_gfx: %s\n", SDL_GetError());
+		abort();
+	}
+	struct cg_shared *shared = calloc(1, sizeof(*shared));
+	cg_shared_init(shared, gfx);
+	SDL_Surface *tileset = sw_tileset(gfx);
+	SDL_FreeSurface(gfx);
+	th.files = argv + 1;
+	th.shared = shared;
+	th.tileset = tileset;
+	th.lock = SDL_CreateMutex();
+	struct runner *r = runner_new(nthreads);
+	runner_run(r, argc - 1, thumb_job, &th);
+	runner_free(r);
+	SDL_DestroyMutex(th.lock);
+	SDL_FreeSurface(tileset);
+	free(shared);
+	return th.nfailed ? 1 : 0;
+}
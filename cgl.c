@@ -22,6 +22,8 @@
 #include "mathgeom.h"
 #include <SDL/SDL_error.h>
 #include <stdio.h>
+#include <stddef.h>
+#include <string.h>
 #include <math.h>
 #include <assert.h>
 #include <errno.h>
@@ -136,6 +138,7 @@ struct cgl *read_cgl(const char *path, uint8_t **out_soin)
 		goto error;
 	if (cgl_read_lpts(cgl, &lpts_tiles, &nlpts_tiles, fp) != 0)
 		goto error;
+	cgl->nstatic = cgl->ntiles;
 	/* join extra tiles from the other sections with those from SOBS,
 	 * fix pointers to point to the new memory */
 	size_t num_tiles = cgl->ntiles + (nvent_tiles + nmagn_tiles +
@@ -488,7 +491,7 @@ int cgl_read_one_vent(struct fan *fan, FILE *fp)
 	fan->dir   = (buf[0] >> 0) & 0x03;
 	fan->power = (buf[0] >> 4) & 0x01;
 	parse_tile_simple(buf2 + 0x00, fan->base, 48, 48);
-	fan->tex_x = fan->base->tex_x;
+	fan->base->anim = FanAnim;
 	parse_tile_normal(buf2 + 0x04, fan->pipes);
 	fan->pipes->collision_test = Bitmap;
 	struct rect r;
@@ -519,7 +522,7 @@ int cgl_read_one_magn(struct magnet *magnet, FILE *fp)
 	magnet->dir = buf[0] & 0x03;
 	parse_tile_simple(buf2 + 0x00, magnet->base, 32, 32);
 	parse_tile_normal(buf2 + 0x04, magnet->magn);
-	magnet->tex_x = magnet->magn->tex_x;
+	magnet->magn->anim = MagnetAnim;
 	magnet->magn->collision_test = Bitmap;
 	struct rect r;
 	parse_rect(buf2 + 0x0e, &r);
@@ -549,7 +552,7 @@ int cgl_read_one_dist(struct airgen *airgen, FILE *fp)
 	airgen->dir  = (buf[0] >> 0) & 0x03;
 	airgen->spin = (buf[0] >> 4) & 0x01;
 	parse_tile_simple(buf2 + 0x00, airgen->base, 40, 40);
-	airgen->tex_x = airgen->base->tex_x;
+	airgen->base->anim = AirgenAnim;
 	parse_tile_normal(buf2 + 0x04, airgen->pipes);
 	airgen->pipes->collision_test = Bitmap;
 	struct rect r;
@@ -672,8 +675,8 @@ int cgl_read_one_pipe(struct bar *bar, FILE *fp)
 		bar->len = width - 2*BAR_BASE_W;
 		break;
 	}
-	bar->btex_x = bar->beg->tex_x;
-	bar->etex_x = bar->end->tex_x;
+	bar->beg->anim = BarBegAnim;
+	bar->end->anim = BarEndAnim;
 	bar->slen = BAR_MIN_LEN;
 	bar->flen = BAR_MIN_LEN;
 	bar->beg->collision_test = bar->end->collision_test = Bitmap;
@@ -953,6 +956,7 @@ int cgl_read_one_lpts(struct airport *airport, FILE *fp)
 			break;
 		case Key:
 			airport->cargo[i]->tex_x = KEY_TEX_X;
+			airport->cargo[i]->anim = KeyAnim;
 			airport->cargo[i]->tex_y = KEY_TEX_Y +
 				airport->c.key*STUFF_SIZE;
 			break;
@@ -1044,3 +1048,130 @@ void cgl_preprocess(struct cgl *cgl)
 		}
 	}
 }
+
+/* ------------------------------------------------------------------------*/
+
+void *cgl_dup(const void *p, size_t size)
+{
+	if (!p || size == 0)
+		return NULL;
+	void *d = malloc(size);
+	memcpy(d, p, size);
+	return d;
+}
+#define DUP(what, n) c->what = cgl_dup(l->what, (n) * sizeof(*l->what))
+/* moves a pointer into l's array to the same element of c's copy, pointers
+ * to anywhere else are left alone */
+#define MOVE(p, what, n) \
+	if ((p) >= l->what && (p) < l->what + (n)) \
+		(p) = c->what + ((p) - l->what)
+#define MOVE_TILE(p) MOVE(p, tiles, l->ntiles)
+/* the same for the untyped tile->data, d, of the i-th tile */
+#define MOVE_DATA(what, n) \
+	if (d >= (const char*)l->what && d < (const char*)(l->what + (n))) \
+		c->tiles[i].data = (char*)c->what + (d - (const char*)l->what)
+/* Copies a level as read and preprocessed, before cg_init. The simulation
+ * state is not copied - the copy has to go through cg_init before it is
+ * stepped, and through cg_free and free_cgl afterwards */
+struct cgl *cgl_copy(const struct cgl *l)
+{
+	struct cgl *c = malloc(sizeof(*c));
+	memcpy(c, l, offsetof(struct cgl, shared));
+	memset((char*)c + offsetof(struct cgl, shared), 0,
+			sizeof(*c) - offsetof(struct cgl, shared));
+	DUP(tiles, l->ntiles);
+	DUP(fans, l->nfans);
+	DUP(magnets, l->nmagnets);
+	DUP(airgens, l->nairgens);
+	DUP(cannons, l->ncannons);
+	DUP(bars, l->nbars);
+	DUP(gates, l->ngates);
+	DUP(lgates, l->nlgates);
+	DUP(airports, l->nairports);
+	for (size_t i = 0; i < l->ntiles; ++i) {
+		const char *d = c->tiles[i].data;
+		MOVE_DATA(fans, l->nfans);
+		MOVE_DATA(magnets, l->nmagnets);
+		MOVE_DATA(airgens, l->nairgens);
+		MOVE_DATA(gates, l->ngates);
+		MOVE_DATA(lgates, l->nlgates);
+		MOVE_DATA(airports, l->nairports);
+	}
+	for (size_t i = 0; i < l->nfans; ++i) {
+		MOVE_TILE(c->fans[i].base);
+		MOVE_TILE(c->fans[i].pipes);
+		MOVE_TILE(c->fans[i].act);
+	}
+	for (size_t i = 0; i < l->nmagnets; ++i) {
+		MOVE_TILE(c->magnets[i].base);
+		MOVE_TILE(c->magnets[i].magn);
+		MOVE_TILE(c->magnets[i].act);
+	}
+	for (size_t i = 0; i < l->nairgens; ++i) {
+		MOVE_TILE(c->airgens[i].base);
+		MOVE_TILE(c->airgens[i].pipes);
+		MOVE_TILE(c->airgens[i].act);
+	}
+	for (size_t i = 0; i < l->ncannons; ++i) {
+		MOVE_TILE(c->cannons[i].beg_base);
+		MOVE_TILE(c->cannons[i].beg_cano);
+		MOVE_TILE(c->cannons[i].end_base);
+		MOVE_TILE(c->cannons[i].end_catch);
+	}
+	for (size_t i = 0; i < l->nbars; ++i) {
+		MOVE_TILE(c->bars[i].beg);
+		MOVE_TILE(c->bars[i].end);
+		MOVE_TILE(c->bars[i].fbar);
+		MOVE_TILE(c->bars[i].sbar);
+	}
+	for (size_t i = 0; i < l->ngates; ++i) {
+		for (size_t j = 0; j < 5; ++j)
+			MOVE_TILE(c->gates[i].base[j]);
+		MOVE_TILE(c->gates[i].bar);
+		MOVE_TILE(c->gates[i].arrow);
+		MOVE_TILE(c->gates[i].act);
+	}
+	for (size_t i = 0; i < l->nlgates; ++i) {
+		for (size_t j = 0; j < 5; ++j)
+			MOVE_TILE(c->lgates[i].base[j]);
+		MOVE_TILE(c->lgates[i].bar);
+		for (size_t j = 0; j < 4; ++j)
+			MOVE_TILE(c->lgates[i].light[j]);
+		MOVE_TILE(c->lgates[i].act);
+	}
+	for (size_t i = 0; i < l->nairports; ++i) {
+		struct airport *ap = &c->airports[i];
+		MOVE_TILE(ap->base);
+		for (size_t j = 0; j < 2; ++j) {
+			MOVE_TILE(ap->stripe[j]);
+			MOVE_TILE(ap->arrow[j]);
+		}
+		for (size_t j = 0; j < 10; ++j)
+			MOVE_TILE(ap->cargo[j]);
+		if (ap->type == Freight)
+			for (size_t j = 0; j < ap->num_cargo; ++j)
+				MOVE(ap->c.freight[j].ap, airports,
+						l->nairports);
+	}
+	MOVE(c->hb, airports, l->nairports);
+	if (l->blocks) {
+		c->blocks = malloc(l->height * sizeof(*c->blocks));
+		for (size_t j = 0; j < l->height; ++j) {
+			c->blocks[j] = malloc(l->width * sizeof(**c->blocks));
+			for (size_t i = 0; i < l->width; ++i) {
+				size_t n = 0;
+				while (l->blocks[j][i][n])
+					++n;
+				c->blocks[j][i] = cgl_dup(l->blocks[j][i],
+						(n + 1) * sizeof(***c->blocks));
+				for (size_t k = 0; k < n; ++k)
+					MOVE_TILE(c->blocks[j][i][k]);
+			}
+		}
+	}
+	return c;
+}
+#undef MOVE_DATA
+#undef MOVE_TILE
+#undef MOVE
+#undef DUP
@@ -23,6 +23,7 @@
 
 #include "mathgeom.h"
 #include "gfx.h"
+#include "timer.h"
 #include <stdio.h>
 #include <stdint.h>
 
@@ -107,7 +108,7 @@ struct tile {
 		Bitmap,
 		/* For transparent or special tiles */
 		NoCollision,
-		/* Collisions are detected using a special function */
+		/* A bullet, tested with the whole rectangle like Rect */
 		Cannon
 	} collision_test;
 	/* What to do if there's a collision */
@@ -120,9 +121,17 @@ struct tile {
 		FanAction,
 		MagnetAction
 	} collision_type;
-	/* necessary for renderer, the number of the most recent frame in
-	 * which the tile was rendered */
-	unsigned int lframe;
+	/* Cosmetic animation, the renderer derives the current frame from
+	 * time; tex_x always points at the first frame */
+	enum anim {
+		NotAnimated = 0,
+		FanAnim,
+		MagnetAnim,
+		AirgenAnim,
+		BarBegAnim,
+		BarEndAnim,
+		KeyAnim
+	} anim;
 	/* additional data necessary for collision detection */
 	void *data;
 };
@@ -136,8 +145,6 @@ struct fan {
 	struct tile *base,
 		    *pipes,
 		    *act;
-	/* x position of the primary texture */
-	int tex_x;
 	double modifier;
 };
 struct magnet {
@@ -145,8 +152,6 @@ struct magnet {
 	struct tile *base,
 		    *magn,
 		    *act;
-	/* x position of the primary texture */
-	int tex_x;
 	double modifier;
 };
 struct airgen {
@@ -158,8 +163,6 @@ struct airgen {
 	struct tile *base,
 		    *pipes,
 		    *act;
-	/* x position of the primary texture */
-	int tex_x;
 	int active;
 };
 struct cannon {
@@ -185,7 +188,8 @@ struct bar {
 	enum orientation orientation;
 	double flen, slen;
 	double fspeed, sspeed;
-	double fnext_change, snext_change;
+	/* set by the bar's timers, cleared when the speed is changed */
+	int fchange_due, schange_due;
 	int len;
 	int gap;
 	int min_s, max_s;
@@ -194,7 +198,6 @@ struct bar {
 		    *end,
 		    *fbar,
 		    *sbar;
-	int btex_x, etex_x;
 };
 enum gate_type{
 	GateLeft = 0,
@@ -252,8 +255,6 @@ struct airport {
 	int has_left_arrow,
 	    has_right_arrow;
 	size_t num_cargo;
-	double transfer_time;
-	int sched_cargo_transfer;
 	int ship_touched;
 	union {
 		int key;
@@ -266,12 +267,91 @@ struct airport {
 	} c /* common */;
 };
 typedef struct tile **block;
+struct cg_shared;
+/* Objects of one kind which have to be stepped. Idle objects sleep off the
+ * list until a collision handler wakes them up. */
+struct active_list {
+	size_t n;
+	size_t *idx;
+	/* for every object of the kind - is it on the list */
+	uint8_t *on;
+};
 /* cgl level contents */
 enum game_status {
 	Alive = 0,
 	Lost,
 	Victory
 };
+/* Things that happen during the simulation. They are pushed by cg_step()
+ * into a ring buffer in struct cgl, so that the OSD, logging and replay tools
+ * do not have to poll the state of the level every frame. */
+enum cg_event_type {
+	/* a freight was moved from airport to ship, arg = freight kind */
+	EvCargoLoaded = 0,
+	/* a freight was delivered to the homebase, arg = freight kind */
+	EvCargoUnloaded,
+	/* a freight held by a killed ship went back to its airport */
+	EvCargoReturned,
+	EvFuelPickup,
+	/* arg = key number */
+	EvKeyPickup,
+	/* arg = Turbo, Life or Cargo */
+	EvExtraPickup,
+	/* tile = what the ship hit */
+	EvShipKilled,
+	/* arg = remaining life */
+	EvShipRestarted,
+	/* tile = the gate's bar */
+	EvGateOpened,
+	EvLanded,
+	EvTakeoff,
+	EvVictory,
+	EvLost
+};
+struct cg_event {
+	enum cg_event_type type;
+	/* the end of the step in which it happened */
+	double time;
+	/* the airport involved, if any */
+	struct airport *airport;
+	/* the tile involved, if any */
+	const struct tile *tile;
+	int arg;
+};
+/* Bullets and explosion particles are fixed pools of parallel arrays, stepped
+ * all at once. Live elements are kept at [0, n). */
+enum pool_consts {
+	/* the pools are stepped in groups of this many elements */
+	POOL_LANES = 4,
+	/* pool sizes must be multiples of POOL_LANES */
+	CG_MAX_BULLETS = 128,
+	KABOOM_PARTICLES = 48
+};
+struct bullets {
+	size_t n;
+	double x[CG_MAX_BULLETS],
+	       y[CG_MAX_BULLETS],
+	       vx[CG_MAX_BULLETS],
+	       vy[CG_MAX_BULLETS],
+	       /* time left until the bullet reaches its catcher */
+	       ttl[CG_MAX_BULLETS];
+	/* the cannon which fired the bullet */
+	uint16_t cannon[CG_MAX_BULLETS];
+};
+/* debris of the exploded ship, only for show */
+struct particles {
+	size_t n;
+	double x[KABOOM_PARTICLES],
+	       y[KABOOM_PARTICLES],
+	       vx[KABOOM_PARTICLES],
+	       vy[KABOOM_PARTICLES],
+	       /* time left until the particle fades out */
+	       ttl[KABOOM_PARTICLES];
+};
+enum cg_event_consts {
+	/* must be a power of 2 */
+	CG_EVENT_RING = 64
+};
 struct cgl {
 	enum {
 		Full,
@@ -282,6 +362,8 @@ struct cgl {
 	size_t width, height;
 	size_t ntiles;
 	struct tile *tiles;
+	/* the first nstatic tiles come from SOBS and never change */
+	size_t nstatic;
 	size_t nfans;
 	struct fan *fans;
 	size_t nmagnets;
@@ -301,14 +383,39 @@ struct cgl {
 	struct airport *hb;
 	block **blocks;
 
+	/* simulation state - everything needed to step this instance,
+	 * independently of any other instance */
+	const struct cg_shared *shared;
+	uint32_t rng;
 	double time;
 	struct ship *ship;
-	double kaboom_end;
+	struct active_list act_airgens,
+			   act_gates,
+			   act_lgates,
+			   act_airports,
+			   act_fans,
+			   act_magnets;
+	/* deadlines: cargo transfers, bar speed changes, respawn, cannon
+	 * shots */
+	struct timer_wheel timers;
+	struct bullets bullets;
+	struct particles kaboom;
+	/* [height][width] - the thinnest obstacle in every block, in pixels */
+	uint8_t *thickness;
+	/* where the phases of cg_step are timed, [PROF_NPHASES]; NULL if
+	 * they are not */
+	struct prof_samples *prof;
+	/* 1 disables sub-stepping of the ship */
+	size_t max_substeps;
 	enum game_status status;
+	/* events ring buffer, nevents is the number of events ever pushed */
+	struct cg_event events[CG_EVENT_RING];
+	uint32_t nevents;
 };
 
 struct cgl *read_cgl(const char*, uint8_t**);
 void cgl_preprocess(struct cgl*);
+struct cgl *cgl_copy(const struct cgl*);
 void free_cgl(struct cgl*);
 
 #endif
@@ -17,12 +17,17 @@
  */
 
 #include "graphics.h"
+#include "swview.h"
+#include "minimap.h"
 #include "osd.h"
 #include "texmgr.h"
 #include "gfx.h"
 #include "cg.h"
+#include "prof.h"
+#include "pacer.h"
 
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 #include <SDL/SDL.h>
 #include <SDL/SDL_image.h>
@@ -33,9 +38,69 @@
 #define SCREEN_H 600
 #define SCALE_STEP 0.2
 #define SCALE_ASTEP 0.01
+/* phase timings are appended here on P */
+#define PROF_FILE "freecg_prof.csv"
+/* the simulation is stepped with a fixed tick */
+#define TICK (1/60.0)
+/* at most this much real time is spent on simulation in one frame */
+#define SIM_BUDGET 0.02
+/* longer frames (e.g. a stall of the window) are not caught up with */
+#define MAX_FRAME_TIME 0.25
+/* default target frame rate, -r overrides it */
+#define FRAME_RATE 60
+/* seconds between reports on the console */
+#define REPORT_PERIOD 5
+
+/* Maps real time to simulation time. The simulation runs as many ticks as
+ * the scaled time of a frame needs; when they do not fit in SIM_BUDGET the
+ * rest is dropped, so the game slows down instead of the frame rate. */
+struct sim_clock {
+	/* index to sim_speeds */
+	int speed;
+	int paused;
+	/* ticks to be run while paused */
+	int steps;
+	/* simulation time not yet stepped */
+	double lag;
+	/* effective simulation speed, smoothed */
+	double effective;
+};
+static const double sim_speeds[] = {0.125, 0.25, 0.5, 1, 2, 4, 8};
+enum {
+	SIM_NSPEEDS = sizeof(sim_speeds) / sizeof(*sim_speeds),
+	SIM_NORMAL_SPEED = 3
+};
 
 int mouse, running;
+struct sim_clock sim = {.speed = SIM_NORMAL_SPEED, .effective = 1};
+struct cg_shared shared;
+uint32_t event_cursor;
+
+/* print the important events on the console */
+void log_event(const struct cg_event *e)
+{
+	switch (e->type) {
+	case EvShipKilled:
+	case EvLost:
+	case EvVictory:
+		printf("%.2f: %s\n", e->time, cg_event_name(e->type));
+		fflush(stdout);
+		break;
+	default:
+		break;
+	}
+}
 
+/* debugging aid: gives or takes away a key; only a key given is an event */
+void toggle_key(int i)
+{
+	struct ship *s = gl.l->ship;
+	s->keys[i] = !s->keys[i];
+	if (s->keys[i])
+		cg_push_event(gl.l, EvKeyPickup, NULL, NULL, i);
+	else
+		osd_update_keys();
+}
 void process_event(SDL_Event *e)
 {
 	switch (e->type) {
@@ -54,16 +119,10 @@ void process_event(SDL_Event *e)
 			mouse = 0;
 			break;
 		case 4:
-			gl.cam.scale += 0.2;
-//			nextscale += SCALE_STEP;
-//			if (nextscale > 10)
-//				nextscale = 10;
+			gl_zoom(1 + SCALE_STEP);
 			break;
 		case 5:
-			gl.cam.scale -= 0.2;
-//			nextscale -= SCALE_STEP;
-//			if (nextscale < 0.4)
-//				nextscale = 0.4;
+			gl_zoom(1 / (1 + SCALE_STEP));
 			break;
 		}
 		break;
@@ -79,17 +138,21 @@ void process_event(SDL_Event *e)
 		case SDLK_ESCAPE:
 			running = 0;
 			break;
+		case SDLK_p:
+			if (prof_export(PROF_FILE, gl.l->time) == 0)
+				printf("phase timings saved to %s\n", PROF_FILE);
+			break;
 		case SDLK_1:
-			gl.l->ship->keys[0] = !gl.l->ship->keys[0];
+			toggle_key(0);
 			break;
 		case SDLK_2:
-			gl.l->ship->keys[1] = !gl.l->ship->keys[1];
+			toggle_key(1);
 			break;
 		case SDLK_3:
-			gl.l->ship->keys[2] = !gl.l->ship->keys[2];
+			toggle_key(2);
 			break;
 		case SDLK_4:
-			gl.l->ship->keys[3] = !gl.l->ship->keys[3];
+			toggle_key(3);
 			break;
 		case SDLK_LEFT:
 			gl.l->ship->rot_speed = -5.5;
@@ -103,6 +166,25 @@ void process_event(SDL_Event *e)
 		case SDLK_o:
 			osd_toggle();
 			break;
+		case SDLK_MINUS:
+		case SDLK_KP_MINUS:
+			sim.speed = max(sim.speed - 1, 0);
+			break;
+		case SDLK_EQUALS:
+		case SDLK_KP_PLUS:
+			sim.speed = min(sim.speed + 1, SIM_NSPEEDS - 1);
+			break;
+		case SDLK_BACKSPACE:
+			sim.speed = SIM_NORMAL_SPEED;
+			break;
+		case SDLK_SPACE:
+			sim.paused = !sim.paused;
+			sim.lag = 0;
+			break;
+		case SDLK_PERIOD:
+			if (sim.paused)
+				++sim.steps;
+			break;
 		default:
 			break;
 		}
@@ -126,10 +208,65 @@ void process_event(SDL_Event *e)
 	}
 }
 
+/* advances the simulation by the real time dt */
+void sim_advance(struct cgl *l, double dt)
+{
+	uint64_t start = prof_now();
+	double sim_start = l->time;
+	if (!sim.paused) {
+		sim.lag += fmin(dt, MAX_FRAME_TIME) * sim_speeds[sim.speed];
+	} else {
+		sim.lag = sim.steps * TICK;
+		sim.steps = 0;
+	}
+	/* the tolerance keeps a tick from being delayed by rounding */
+	while (sim.lag >= TICK * (1 - 1e-6)) {
+		cg_step(l, l->time + TICK);
+		sim.lag -= TICK;
+		if ((prof_now() - start) / 1e9 > SIM_BUDGET) {
+			sim.lag = 0;
+			break;
+		}
+	}
+	if (!sim.paused && dt > 0)
+		sim.effective += ((l->time - sim_start) / fmin(dt, MAX_FRAME_TIME) -
+				sim.effective) * 0.1;
+	osd_set_speed(sim.effective, sim.paused);
+}
+
 int main(int argc, char *argv[])
 {
+	const char *prog = argv[0];
+	double rate = FRAME_RATE;
+	int vsync = 1;
+	const char *frames_csv = NULL;
+	int software = 0;
+	while (argc > 1 && argv[1][0] == '-') {
+		if (strcmp(argv[1], "-n") == 0) {
+			vsync = 0;
+			argc -= 1, argv += 1;
+		} else if (strcmp(argv[1], "-S") == 0) {
+			software = 1;
+			argc -= 1, argv += 1;
+		} else if (strcmp(argv[1], "-r") == 0 && argc > 2) {
+			rate = atof(argv[2]);
+			argc -= 2, argv += 2;
+		} else if (strcmp(argv[1], "-c") == 0 && argc > 2) {
+			frames_csv = argv[2];
+			argc -= 2, argv += 2;
+		} else {
+			break;
+		}
+	}
 	if (!(argc == 2 || argc == 4)) {
-		printf("Usage: %s file.cgl [width height]\n", argv[0]);
+		printf("Usage: %s [-r fps] [-n] [-S] [-c frames.csv] file.cgl "
+		       "[width height]\n"
+		       "  -r fps  target frame rate, 0 for unlimited "
+		       "(default %d)\n"
+		       "  -n      do not wait for the vertical retrace\n"
+		       "  -S      draw without OpenGL\n"
+		       "  -c file write the times of every frame to file\n",
+		       prog, FRAME_RATE);
 		exit(-1);
 	}
 	SDL_Surface *screen;
@@ -154,56 +291,141 @@ int main(int argc, char *argv[])
 		abort();
 	}
 	cgl_preprocess(cgl);
-	cg_init(cgl);
-	make_collision_map(gfx, cmap);
+	cg_shared_init(&shared, gfx);
+	cg_init(cgl, &shared, 0);
 	if (SDL_Init(SDL_INIT_VIDEO) != 0) {
 		fprintf(stderr, "SDL failed: %s\n", SDL_GetError());
 		abort();
 	}
+	/* the framebuffer of the software renderer is 32 bit */
+	Uint32 mode = software ? SDL_SWSURFACE : MODE;
+	int bpp = software ? 32 : 0;
+	if (!software)
+		SDL_GL_SetAttribute(SDL_GL_SWAP_CONTROL, vsync);
 	if (argc == 4) {
 		int w = atoi(argv[2]),
 		    h = atoi(argv[3]);
 		if (w && h)
-			screen = SDL_SetVideoMode(w, h, 0, MODE);
+			screen = SDL_SetVideoMode(w, h, bpp, mode);
 		else
 			fprintf(stderr, "Wrong resolution");
 	} else {
-		screen = SDL_SetVideoMode(SCREEN_W, SCREEN_H, 0, MODE);
+		screen = SDL_SetVideoMode(SCREEN_W, SCREEN_H, bpp, mode);
+	}
+	/* the minimap is drawn by the software renderer once per level */
+	SDL_Surface *tileset = sw_tileset(gfx),
+		    *map = tileset ? minimap_render(cgl, tileset) : NULL;
+	/* the tileset, the font, the OSD and the minimap share one texture
+	 * if they fit */
+	const SDL_Surface *images[5] = {gfx, png, osd, map};
+	size_t nimages = map ? 4 : 3;
+	struct texmgr *tms[5] = {NULL};
+	if (software) {
+		/* SDL_UpdateRects does not wait for the retrace */
+		vsync = 0;
+		SDL_Surface *atlas = tm_pack_atlas(images, nimages, tms,
+				SW_ATLAS_SIZE);
+		if (!atlas) {
+			fprintf(stderr, "tm_pack_atlas: images too large\n");
+			abort();
+		}
+		sw_init(screen, cgl, atlas, tms[0], tms[1], tms[2], tms[3]);
+	} else {
+		gl_resize_viewport(screen->w, screen->h);
+		/* the driver may ignore the request either way */
+		if (SDL_GL_GetAttribute(SDL_GL_SWAP_CONTROL, &vsync) != 0)
+			vsync = 0;
+		/* the white image goes with the tileset in any case */
+		SDL_Surface *white = gl_white_image();
+		struct texmgr *wtm;
+		images[nimages] = white;
+		if (tm_request_atlas(images, nimages + 1, tms) == 0) {
+			wtm = tms[nimages];
+			tms[nimages] = NULL;
+		} else {
+			const SDL_Surface *tiles[] = {gfx, white};
+			struct texmgr *ttms[2];
+			if (tm_request_atlas(tiles, 2, ttms) != 0) {
+				fprintf(stderr, "tm_request_atlas: "
+						"tileset too large\n");
+				abort();
+			}
+			tms[0] = ttms[0];
+			wtm = ttms[1];
+			tms[1] = tm_request_texture(png);
+			tms[2] = tm_request_texture(osd);
+			if (map)
+				tms[3] = tm_request_texture(map);
+		}
+		SDL_FreeSurface(white);
+		gl_init(cgl, tms[0], tms[1], tms[2], tms[3], wtm);
+		/* zoomed far out the level is drawn from baked images */
+		if (tileset)
+			gl_lod_init(tileset);
 	}
-	gl_resize_viewport(screen->w, screen->h);
-	struct texmgr *ttm = tm_request_texture(gfx);
-	struct texmgr *fnt = tm_request_texture(png);
-	struct texmgr *otm = tm_request_texture(osd);
-	gl_init(cgl, ttm, fnt, otm);
-	int t = SDL_GetTicks(),
-	    nt = t,
-	    time = t,
-	    fr = 0;
+	if (tileset)
+		SDL_FreeSurface(tileset);
+	if (map)
+		SDL_FreeSurface(map);
+	struct pacer pacer;
+	pacer_init(&pacer, rate, vsync);
+	double time = 0,
+	       report = 0;
+	unsigned int fr = gl.frame;
+	uint64_t streamed = 0;
 	running = 1;
 	mouse = 0;
+	prof_enable(1);
+	cgl->prof = prof_phases();
+	if (frames_csv)
+		prof_frame_dump(frames_csv);
 	SDL_Event e;
 	while (running) {
+		double dt = pacer_wait(&pacer);
+		gl_frame_begin();
+		time += dt;
 		while (SDL_PollEvent(&e))
 			process_event(&e);
-		time = SDL_GetTicks();
-		nt = time - t;
-		cg_step(cgl, time / 1000.0);
-		if (nt > 5000) {
-			printf("%d frames in %d ms - %.1f fps\n",
-					gl.frame - fr, nt, (float)(gl.frame - fr) / nt * 1000);
-			if (cgl->status == Lost)
-				printf("Dead. Game over!");
-			if (cgl->status == Victory)
-				printf("You won!");
+		sim_advance(cgl, dt);
+		const struct cg_event *ev;
+		while ((ev = cg_next_event(cgl, &event_cursor)))
+			log_event(ev);
+		if (time - report > REPORT_PERIOD) {
+			struct pacer_stats ps;
+			unsigned int nf = gl.frame - fr;
+			pacer_report(&pacer, &ps);
+			printf("%u frames in %.0f ms - %.1f fps, simulation at "
+					"%.2fx\n", nf, (time - report) * 1000,
+					nf / (time - report), sim.effective);
+			printf("frame time %.2f ms, jitter %.2f ms, worst "
+					"%.2f ms (target %.2f ms%s)\n",
+					ps.avg * 1000, ps.jitter * 1000,
+					ps.max * 1000, pacer.period / 1e6,
+					vsync ? ", vsync" : "");
+			printf("streamed %.1f KiB per frame\n",
+					(gl.stream.bytes - streamed) / 1024.0 /
+					(nf ? nf : 1));
+			prof_print(stdout);
 			fflush(stdout);
 
-			t += nt;
+			report = time;
 			fr = gl.frame;
+			streamed = gl.stream.bytes;
 		}
 		gl.cam.nx = cgl->ship->x + SHIP_W/2.0;
 		gl.cam.ny = cgl->ship->y + SHIP_H/2.0;
-		gl_update_window(time / 1000.0);
+		if (software)
+			sw_update_window(time);
+		else
+			gl_update_window(time);
 	}
+	if (software)
+		sw_free();
+	else
+		gl_free();
+	prof_frame_print(stdout);
+	prof_frame_close();
+	cg_free(cgl);
 	free_cgl(cgl);
 	return 0;
 }
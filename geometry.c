@@ -36,7 +36,7 @@ int normalize_angle(double *a)
 void ship_to_tile(const struct ship *s, struct tile *t)
 {
 	t->w = SHIP_W, t->h = SHIP_H;
-	t->x = (int)round(s->x), t->y = (int)round(s->y);
+	t->x = iround(s->x), t->y = iround(s->y);
 	if (s->engine) {
 		t->tex_x = SHIP_ON_IMG_X;
 		t->tex_y = SHIP_ON_IMG_Y;
@@ -44,10 +44,9 @@ void ship_to_tile(const struct ship *s, struct tile *t)
 		t->tex_x = SHIP_OFF_IMG_X;
 		t->tex_y = SHIP_OFF_IMG_Y;
 	}
-	double drot = s->rot + M_PI/2;
-	normalize_angle(&drot);
-	int rot = drot / (2*M_PI) * 24;
-	t->tex_x += rot * SHIP_W;
+	/* sprite 0 points up, orientation 0 points right */
+	int sprite = (s->orient + SHIP_NUM_ANGLES/4) % SHIP_NUM_ANGLES;
+	t->tex_x += sprite * SHIP_W;
 }
 
 int tiles_intersect(const struct tile *t1, const struct tile *t2,
@@ -77,3 +76,54 @@ int discrete_rot(double rot)
 {
 	return (int)(rot/(2*M_PI) * 360) / 15;
 }
+
+/* ==================== Object animators ==================== */
+/* Animations of objects do not influence the gameplay, so they are computed
+ * only for the tiles being drawn, as a function of time */
+static const int magnet_anim_order[] = {0, 1, 2, 1};
+static const int fan_anim_order[] = {0, 1, 2};
+static const int airgen_anim_order[] = {0, 1, 2, 3, 4, 5, 6, 7};
+static const int bar_anim_order[][2] = {{0, 1}, {1, 0}};
+static const int key_anim_order[] = {0, 1, 2, 3, 4, 5, 6, 7};
+int anim_tex_x(const struct tile *tile, double time)
+{
+	int phase;
+	switch (tile->anim) {
+	case FanAnim:
+		phase = round(time * FAN_ANIM_SPEED);
+		return tile->tex_x + fan_anim_order[phase % 3] * tile->w;
+	case MagnetAnim:
+		phase = round(time * MAGNET_ANIM_SPEED);
+		return tile->tex_x + magnet_anim_order[phase % 4] * tile->w;
+	case AirgenAnim:
+		phase = round(time * AIRGEN_ANIM_SPEED);
+		return tile->tex_x + airgen_anim_order[phase % 8] * tile->w;
+	case BarBegAnim:
+		phase = round(time * BAR_ANIM_SPEED);
+		return tile->tex_x + bar_anim_order[0][phase % 2] * BAR_TEX_OFFSET;
+	case BarEndAnim:
+		phase = round(time * BAR_ANIM_SPEED);
+		return tile->tex_x + bar_anim_order[1][phase % 2] * BAR_TEX_OFFSET;
+	case KeyAnim:
+		phase = round(time * KEY_ANIM_SPEED);
+		return tile->tex_x + key_anim_order[phase % 8] * tile->w;
+	case NotAnimated:
+		break;
+	}
+	return tile->tex_x;
+}
+/* whether a tile is drawn at the time, i.e. it is not transparent or a
+ * blinking light in its dark phase */
+int tile_shown(const struct tile *tile, double time)
+{
+	switch (tile->type) {
+	case Transparent:
+		return 0;
+	case Blink:
+		return (int)round(time * BLINK_SPEED) % 2 == 0;
+	case Simple:
+		break;
+	}
+	return 1;
+}
+/* ==================== /Object animators ==================== */
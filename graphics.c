@@ -17,25 +17,72 @@
  * along with FreeCG. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#define GL_GLEXT_PROTOTYPES
 #include "graphics.h"
 #include "osd.h"
 #include "mathgeom.h"
 #include "texmgr.h"
+#include "prof.h"
+#include "swrender.h"
 #include <assert.h>
 #include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 /* ==================== Gamefield graphics ==================== */
 
 struct glengine gl;
+/* whether the context is at least of version major.minor or has extension
+ * ext (if not NULL) */
+int gl_has(int major, int minor, const char *ext)
+{
+	int maj = 0, min = 0;
+	const char *ver = (const char*)glGetString(GL_VERSION),
+	           *exts = (const char*)glGetString(GL_EXTENSIONS);
+	if (ver && sscanf(ver, "%d.%d", &maj, &min) == 2 &&
+			(maj > major || (maj == major && min >= minor)))
+		return 1;
+	return ext && exts && strstr(exts, ext);
+}
 void gl_draw_sprite(double, double, const struct tile*);
+/* one vertex of a sprite, with normalized texture coordinates */
+static inline GLfloat *gl_put_vertex(GLfloat *v, double x, double y, double z,
+		int tex_x, int tex_y)
+{
+	v[0] = x, v[1] = y, v[2] = z;
+	v[3] = (double)(gl.ttm->x + tex_x) / gl.ttm->w;
+	v[4] = (double)(gl.ttm->y + tex_y) / gl.ttm->h;
+	return v + VERTEX_FLOATS;
+}
+/* the colour of a streamed vertex, which follows the vertex */
+static inline GLfloat *gl_put_color(GLfloat *v, const GLubyte rgba[4])
+{
+	memcpy(v, rgba, 4);
+	return v + 1;
+}
+static const GLubyte gl_white[4] = {255, 255, 255, 255};
+
+void gl_static_init(struct gl_static*, const struct cgl*);
+void gl_static_free(struct gl_static*);
+void gl_stream_init(struct gl_stream*);
+void gl_stream_free(struct gl_stream*);
+void gl_timer_init(struct gl_frame_timer*);
+void gl_timer_free(struct gl_frame_timer*);
+void gl_visible_init(struct gl_visible*, const struct cgl*);
+void gl_visible_free(struct gl_visible*);
 
 void gl_init(struct cgl* l, struct texmgr *ttm, struct texmgr *ftm,
-		struct texmgr *otm)
+		struct texmgr *otm, struct texmgr *mtm, struct texmgr *wtm)
 {
+	assert(wtm->texno == ttm->texno);
 	gl.ttm = ttm;
 	gl.ftm = ftm;
 	gl.otm = otm;
-	gl.frame = 0;
+	gl.mtm = mtm;
+	gl.wtm = wtm;
+	/* 0 stands for "never drawn" in the visibility stamps */
+	gl.frame = 1;
 	gl.l = l;
 	gl.cam.scale = 1;
 	gl.cam.x = l->width  * BLOCK_SIZE / 2;
@@ -45,9 +92,37 @@ void gl_init(struct cgl* l, struct texmgr *ttm, struct texmgr *ftm,
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	glClearColor(0.1, 0.1, 0.1, 1);
+	gl_static_init(&gl.st, l);
+	gl_stream_init(&gl.stream);
+	gl_visible_init(&gl.vis, l);
+	gl_timer_init(&gl.ft);
 	osd_init();
 	SDL_ShowCursor(SDL_DISABLE);
 }
+/* Bullets and debris are streamed with the sprites, as quads of the colour
+ * of their vertices over this image. It has to be packed in the texture of
+ * the tileset. */
+SDL_Surface *gl_white_image(void)
+{
+	SDL_Surface *white = SDL_CreateRGBSurface(0, WHITE_SIDE, WHITE_SIDE,
+			32, RMASK, GMASK, BMASK, AMASK);
+	if (!white)
+		return NULL;
+	/* blits into the atlas have to copy the alpha, not blend */
+	SDL_SetAlpha(white, 0, 255);
+	SDL_FillRect(white, NULL, RMASK | GMASK | BMASK | AMASK);
+	return white;
+}
+void gl_free(void)
+{
+	gl_static_free(&gl.st);
+	gl_stream_free(&gl.stream);
+	gl_visible_free(&gl.vis);
+	gl_timer_free(&gl.ft);
+	if (gl.lod.tex)
+		glDeleteTextures(1, &gl.lod.tex);
+	gl.lod.tex = 0;
+}
 void gl_resize_viewport(double w, double h)
 {
 	gl.win_w = w, gl.win_h = h;
@@ -57,7 +132,9 @@ void gl_resize_viewport(double w, double h)
 	glOrtho(0, w, 0, h, -5, 5);
 	glMatrixMode(GL_MODELVIEW);
 }
-void gl_look_at(double x, double y, double scale)
+/* the part of the level shown with the window centered at (x, y), kept inside
+ * the level */
+void gl_set_viewport(double x, double y, double scale)
 {
 	gl.viewport.w = gl.win_w/scale;
 	gl.viewport.h = gl.win_h/scale;
@@ -65,18 +142,24 @@ void gl_look_at(double x, double y, double scale)
 			fmax(0, x - gl.viewport.w/2));
 	gl.viewport.y = fmin(gl.l->height*BLOCK_SIZE - gl.viewport.h,
 			fmax(0, y - gl.viewport.h/2));
+}
+void gl_look_at(double x, double y, double scale)
+{
+	gl_set_viewport(x, y, scale);
 	glScalef(scale, scale, 1);
 	glTranslated(-gl.viewport.x, -gl.viewport.y, 0);
 }
 
 void gl_draw_scene()
 {
-	extern void fix_lframes(struct cgl*),
-	            gl_draw_block(struct tile *[]),
-		    gl_draw_ship(void);
+	extern void gl_draw_dynamic(double, double, double, double),
+		    gl_draw_ship(void),
+		    gl_draw_bullets(void),
+		    gl_draw_kaboom(void),
+		    gl_draw_static(double, double, double, double),
+		    gl_stream_flush(struct gl_stream*),
+		    gl_draw_lod(void);
 	gl_look_at(gl.cam.x, gl.cam.y, gl.cam.scale);
-	if (gl.frame == 0)
-		fix_lframes(gl.l);
 	double x1 = fmax(0, gl.viewport.x),
 	       y1 = fmax(0, gl.viewport.y),
 	       x2 = fmin(gl.viewport.x + gl.viewport.w,
@@ -84,88 +167,716 @@ void gl_draw_scene()
 	       y2 = fmin(gl.viewport.y + gl.viewport.h,
 			       gl.l->height * BLOCK_SIZE);
 	glColor4f(1, 1, 1, 1);
+	/* far enough out, the cost must not depend on how much is in view */
+	if (gl.lod.tex && gl.cam.scale < LOD_SCALE) {
+		gl_draw_lod();
+		/* bullets and debris are not baked, they fly over the image and
+		 * under the marks */
+		gl.stream.dz = 0.5;
+		if (gl.l->bullets.n)
+			gl_draw_bullets();
+		if (gl.l->kaboom.n)
+			gl_draw_kaboom();
+		gl_stream_flush(&gl.stream);
+		gl.frame++;
+		return;
+	}
 	gl_bind_texture(gl.ttm);
-	gl_draw_ship();
+	gl.stream.dz = 0;
+	if (!gl.l->ship->dead)
+		gl_draw_ship();
+	if (gl.l->bullets.n)
+		gl_draw_bullets();
+	if (gl.l->kaboom.n)
+		gl_draw_kaboom();
 	glPushMatrix();
 	glTranslated(0, 0, 0.1);
-	glBegin(GL_QUADS);
-	for (size_t j = y1/BLOCK_SIZE; j*BLOCK_SIZE < y2; ++j)
-		for (size_t i = x1/BLOCK_SIZE; i*BLOCK_SIZE < x2; ++i)
-			gl_draw_block(gl.l->blocks[j][i]);
-	glEnd();
+	gl_draw_static(x1, y1, x2, y2);
 	glPopMatrix();
+	/* the dynamic tiles go to the same stream as the ship, lifted like the
+	 * static ones above */
+	gl.stream.dz = 0.1;
+	gl_draw_dynamic(x1, y1, x2, y2);
+	gl_stream_flush(&gl.stream);
 	gl.frame++;
 }
-void fix_lframes(struct cgl *level)
-{
-	for (size_t i = 0; i < level->ntiles; ++i)
-		level->tiles[i].lframe = 0;
-	gl.frame = 1;
-}
 void gl_draw_ship(void)
 {
 	struct tile tile;
 	ship_to_tile(gl.l->ship, &tile); /* to get tex coordinates */
-	glBegin(GL_QUADS);
 	gl_draw_sprite(gl.l->ship->x, gl.l->ship->y, &tile);
-	glEnd();
+}
+/* a square of one colour, sampling the middle of the white image */
+void gl_draw_flat(double x, double y, double side, const GLubyte rgba[4])
+{
+	extern GLfloat *gl_stream_alloc(struct gl_stream*, size_t);
+	GLfloat *v = gl_stream_alloc(&gl.stream, 4);
+	int tex_x = gl.wtm->x - gl.ttm->x + WHITE_SIDE/2,
+	    tex_y = gl.wtm->y - gl.ttm->y + WHITE_SIDE/2;
+	double z = gl.stream.dz;
+	v = gl_put_color(gl_put_vertex(v, x, y, z, tex_x, tex_y), rgba);
+	v = gl_put_color(gl_put_vertex(v, x, y + side, z, tex_x, tex_y), rgba);
+	v = gl_put_color(gl_put_vertex(v, x + side, y + side, z,
+				tex_x, tex_y), rgba);
+	v = gl_put_color(gl_put_vertex(v, x + side, y, z, tex_x, tex_y), rgba);
+}
+/* bullets are plain squares at the ship's depth */
+void gl_draw_bullets(void)
+{
+	static const GLubyte color[4] = {255, 230, 128, 255};
+	const struct bullets *b = &gl.l->bullets;
+	for (size_t i = 0; i < b->n; ++i)
+		gl_draw_flat(b->x[i], b->y[i], BULLET_SIDE, color);
+}
+/* the debris of the ship, fading out */
+void gl_draw_kaboom(void)
+{
+	const struct particles *p = &gl.l->kaboom;
+	const double side = 2;
+	for (size_t i = 0; i < p->n; ++i) {
+		if (p->ttl[i] <= 0)
+			continue;
+		double t = p->ttl[i] / KABOOM_TIME;
+		const GLubyte color[4] = {
+			255, 255 * (0.3 + 0.7*t), 255 * 0.2*t, 255 * t
+		};
+		gl_draw_flat(p->x[i], p->y[i], side, color);
+	}
 }
 /* this function uses x and y as coordinates instead of tile's x and y, to
  * support subpixel rendering */
 void gl_draw_sprite(double x, double y, const struct tile *tile)
 {
-	tm_coord_tl(gl.ttm, tile->tex_x, tile->tex_y, tile->w, tile->h);
-	glVertex3d(x, y, tile->z);
-	tm_coord_bl(gl.ttm, tile->tex_x, tile->tex_y, tile->w, tile->h);
-	glVertex3d(x, y + tile->h, tile->z);
-	tm_coord_br(gl.ttm, tile->tex_x, tile->tex_y, tile->w, tile->h);
-	glVertex3d(x + tile->w, y + tile->h, tile->z);
-	tm_coord_tr(gl.ttm, tile->tex_x, tile->tex_y, tile->w, tile->h);
-	glVertex3d(x + tile->w, y, tile->z);
+	extern GLfloat *gl_stream_alloc(struct gl_stream*, size_t);
+	GLfloat *v = gl_stream_alloc(&gl.stream, 4);
+	double z = tile->z + gl.stream.dz;
+	v = gl_put_color(gl_put_vertex(v, x, y, z,
+				tile->tex_x, tile->tex_y), gl_white);
+	v = gl_put_color(gl_put_vertex(v, x, y + tile->h, z,
+				tile->tex_x, tile->tex_y + tile->h), gl_white);
+	v = gl_put_color(gl_put_vertex(v, x + tile->w, y + tile->h, z,
+				tile->tex_x + tile->w, tile->tex_y + tile->h),
+			gl_white);
+	v = gl_put_color(gl_put_vertex(v, x + tile->w, y, z,
+				tile->tex_x + tile->w, tile->tex_y), gl_white);
+}
+/* ==================== Visibility ==================== */
+/* The renderer keeps its own index of the dynamic tiles in each block and its
+ * own record of which tiles were drawn in the current frame, so the level is
+ * only read while drawing. */
+void gl_visible_init(struct gl_visible *v, const struct cgl *l)
+{
+	size_t nblocks = l->width * l->height;
+	v->first = calloc(nblocks + 1, sizeof(*v->first));
+	v->row = calloc(l->height, sizeof(*v->row));
+	v->col = calloc(l->width, sizeof(*v->col));
+	v->drawn = calloc(l->ntiles, sizeof(*v->drawn));
+	/* static tiles come from the static geometry */
+	for (size_t j = 0; j < l->height; ++j)
+		for (size_t i = 0; i < l->width; ++i)
+			for (struct tile **t = l->blocks[j][i]; *t; ++t)
+				if ((size_t)(*t - l->tiles) >= l->nstatic)
+					++v->first[j*l->width + i + 1];
+	for (size_t b = 0; b < nblocks; ++b)
+		v->first[b + 1] += v->first[b];
+	v->ids = malloc(v->first[nblocks] * sizeof(*v->ids));
+	for (size_t j = 0; j < l->height; ++j)
+		for (size_t i = 0; i < l->width; ++i) {
+			size_t k = v->first[j*l->width + i];
+			for (struct tile **t = l->blocks[j][i]; *t; ++t)
+				if ((size_t)(*t - l->tiles) >= l->nstatic)
+					v->ids[k++] = *t - l->tiles;
+			if (k > v->first[j*l->width + i])
+				v->row[j] = v->col[i] = 1;
+		}
+}
+void gl_visible_free(struct gl_visible *v)
+{
+	free(v->first);
+	free(v->ids);
+	free(v->row);
+	free(v->col);
+	free(v->drawn);
+	v->first = NULL;
+	v->ids = NULL;
+	v->row = v->col = NULL;
+	v->drawn = NULL;
 }
-/* Each tile may be referenced by many blocks. This function makes sure each
- * tile is drawn to the buffer only once */
-void gl_draw_block(struct tile *tiles[])
+/* Each tile may be referenced by many blocks. This function draws the dynamic
+ * tiles of the blocks intersecting the rectangle (x1, y1), (x2, y2), each one
+ * only once */
+void gl_draw_dynamic(double x1, double y1, double x2, double y2)
 {
 	extern void gl_dispatch_drawing(const struct tile*);
-	for (size_t i = 0; tiles[i]; ++i) {
-		/* if the tile has not been drawn in current frame yet, draw
-		 * and update tile's frame number */
-		if (tiles[i]->lframe != gl.frame) {
-			gl_dispatch_drawing(tiles[i]);
-			tiles[i]->lframe = gl.frame;
+	struct gl_visible *v = &gl.vis;
+	const struct cgl *l = gl.l;
+	for (size_t j = y1/BLOCK_SIZE; j*BLOCK_SIZE < y2; ++j) {
+		if (!v->row[j])
+			continue;
+		for (size_t i = x1/BLOCK_SIZE; i*BLOCK_SIZE < x2; ++i) {
+			if (!v->col[i])
+				continue;
+			size_t b = j*l->width + i;
+			for (size_t k = v->first[b]; k < v->first[b + 1]; ++k) {
+				uint32_t id = v->ids[k];
+				if (v->drawn[id] != gl.frame) {
+					v->drawn[id] = gl.frame;
+					gl_dispatch_drawing(&l->tiles[id]);
+				}
+			}
 		}
 	}
 }
-inline void gl_draw_simple_tile(const struct tile *tile)
+/* ==================== /Visibility ==================== */
+
+/* ==================== Static geometry ==================== */
+/* SOBS tiles never change, so they are uploaded once per level, grouped into
+ * chunks, with texture coordinates already normalized. Where framebuffer
+ * objects are available the chunks are additionally pre-rendered into
+ * textures, so a visible chunk costs a single quad. */
+static inline void gl_bind_texno(GLuint texno)
 {
-	gl_draw_sprite(tile->x, tile->y, tile);
+	if (gl.curtex != texno) {
+		glBindTexture(GL_TEXTURE_2D, texno);
+		gl.curtex = texno;
+	}
+}
+void gl_static_init(struct gl_static *st, const struct cgl *l)
+{
+	extern void gl_cache_init(struct gl_static*);
+	const size_t side = CHUNK_BLOCKS * BLOCK_SIZE;
+	st->w = (l->width  + CHUNK_BLOCKS - 1) / CHUNK_BLOCKS;
+	st->h = (l->height + CHUNK_BLOCKS - 1) / CHUNK_BLOCKS;
+	st->chunks = calloc(st->w * st->h, sizeof(*st->chunks));
+	st->vbo = 0;
+	/* a tile belongs to the chunk of its origin; count quads per chunk
+	 * first, then turn the counts into offsets */
+	size_t *chunk_of = malloc(l->nstatic * sizeof(*chunk_of));
+	for (size_t k = 0; k < l->nstatic; ++k) {
+		const struct tile *t = &l->tiles[k];
+		size_t i = fmin(t->x / side, st->w - 1),
+		       j = fmin(t->y / side, st->h - 1);
+		chunk_of[k] = j * st->w + i;
+		st->chunks[chunk_of[k]].count += 4;
+	}
+	GLint nverts = 0;
+	for (size_t c = 0; c < st->w * st->h; ++c) {
+		st->chunks[c].first = nverts;
+		nverts += st->chunks[c].count;
+		st->chunks[c].count = 0;
+		st->chunks[c].slot = -1;
+	}
+	st->data = malloc(nverts * VERTEX_FLOATS * sizeof(*st->data));
+	for (size_t k = 0; k < l->nstatic; ++k) {
+		const struct tile *t = &l->tiles[k];
+		struct gl_chunk *c = &st->chunks[chunk_of[k]];
+		GLfloat *v = st->data +
+			(c->first + c->count) * VERTEX_FLOATS;
+		v = gl_put_vertex(v, t->x, t->y, t->z,
+				t->tex_x, t->tex_y);
+		v = gl_put_vertex(v, t->x, t->y + t->h, t->z,
+				t->tex_x, t->tex_y + t->h);
+		v = gl_put_vertex(v, t->x + t->w, t->y + t->h, t->z,
+				t->tex_x + t->w, t->tex_y + t->h);
+		v = gl_put_vertex(v, t->x + t->w, t->y, t->z,
+				t->tex_x + t->w, t->tex_y);
+		if (c->count == 0) {
+			c->box.x = t->x, c->box.y = t->y;
+			c->box.w = t->w, c->box.h = t->h;
+		} else {
+			int x2 = fmax(c->box.x + c->box.w, t->x + t->w),
+			    y2 = fmax(c->box.y + c->box.h, t->y + t->h);
+			c->box.x = fmin(c->box.x, t->x);
+			c->box.y = fmin(c->box.y, t->y);
+			c->box.w = x2 - c->box.x;
+			c->box.h = y2 - c->box.y;
+		}
+		c->count += 4;
+	}
+	free(chunk_of);
+	/* tiles stick out of their chunk by less than a chunk, so a chunk's
+	 * area is reached only by its own tiles and those of the chunks above
+	 * and to the left of it */
+	for (size_t j = 0; j < st->h; ++j)
+		for (size_t i = 0; i < st->w; ++i) {
+			struct gl_chunk *c = &st->chunks[j*st->w + i];
+			for (size_t jj = j ? j - 1 : j; jj <= j; ++jj)
+				for (size_t ii = i ? i - 1 : i; ii <= i; ++ii) {
+					const struct gl_chunk *n =
+						&st->chunks[jj*st->w + ii];
+					c->filled |= n->count &&
+						n->box.x + n->box.w > i*side &&
+						n->box.y + n->box.h > j*side;
+				}
+		}
+	/* without vertex buffers the same data is drawn from client memory */
+	if (nverts > 0 && gl_has(1, 5, NULL)) {
+		glGenBuffers(1, &st->vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, st->vbo);
+		glBufferData(GL_ARRAY_BUFFER,
+				nverts * VERTEX_FLOATS * sizeof(*st->data),
+				st->data, GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		free(st->data);
+		st->data = NULL;
+	}
+	gl_cache_init(st);
+}
+void gl_static_free(struct gl_static *st)
+{
+	extern void gl_cache_free(struct gl_chunk_cache*);
+	gl_cache_free(&st->cache);
+	if (st->vbo)
+		glDeleteBuffers(1, &st->vbo);
+	free(st->data);
+	free(st->chunks);
+	st->vbo = 0;
+	st->data = NULL;
+	st->chunks = NULL;
+}
+int gl_static_arrays_begin(const struct gl_static *st)
+{
+	const GLsizei stride = VERTEX_FLOATS * sizeof(GLfloat);
+	if (st->vbo) {
+		glBindBuffer(GL_ARRAY_BUFFER, st->vbo);
+		glVertexPointer(3, GL_FLOAT, stride, (const GLvoid*)0);
+		glTexCoordPointer(2, GL_FLOAT, stride,
+				(const GLvoid*)(3 * sizeof(GLfloat)));
+	} else if (st->data) {
+		glVertexPointer(3, GL_FLOAT, stride, st->data);
+		glTexCoordPointer(2, GL_FLOAT, stride, st->data + 3);
+	} else {
+		return 0;
+	}
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	gl_bind_texture(gl.ttm);
+	return 1;
+}
+void gl_static_arrays_end(const struct gl_static *st)
+{
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	if (st->vbo)
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
-inline void gl_draw_blinking_tile(const struct tile *tile)
+/* draws the tiles of chunk (i, j) and of the chunks which reach into it */
+void gl_static_draw_around(const struct gl_static *st, size_t i, size_t j)
 {
-	int phase = round(gl.l->time * BLINK_SPEED);
-	if (phase % 2 == 0)
-		gl_draw_sprite(tile->x, tile->y, tile);
+	for (size_t jj = j ? j - 1 : j; jj <= j; ++jj)
+		for (size_t ii = i ? i - 1 : i; ii <= i; ++ii) {
+			const struct gl_chunk *c = &st->chunks[jj*st->w + ii];
+			if (c->count)
+				glDrawArrays(GL_QUADS, c->first, c->count);
+		}
 }
+
+/* ---------- Chunk cache ---------- */
+/* Baked chunks live in a fixed number of textures. All of them are baked
+ * when the level is loaded if they fit, otherwise the least recently drawn
+ * one is replaced when a chunk comes into view. */
+void gl_cache_free(struct gl_chunk_cache *cc)
+{
+	if (cc->nslots) {
+		glDeleteTextures(cc->nslots, cc->tex);
+		glDeleteFramebuffers(1, &cc->fbo);
+	}
+	cc->nslots = 0;
+}
+/* renders chunk c into a texture, returns its slot in the cache or -1 if all
+ * the slots hold chunks drawn in the current frame */
+int gl_cache_bake(struct gl_static *st, size_t c)
+{
+	struct gl_chunk_cache *cc = &st->cache;
+	const double side = CHUNK_BLOCKS * BLOCK_SIZE;
+	int slot = -1;
+	for (size_t s = 0; s < cc->nslots; ++s) {
+		if (cc->chunk[s] < 0) {
+			slot = s;
+			break;
+		}
+		if (cc->frame[s] != gl.frame &&
+				(slot < 0 || cc->frame[s] < cc->frame[slot]))
+			slot = s;
+	}
+	if (slot < 0)
+		return -1;
+	if (cc->chunk[slot] >= 0)
+		st->chunks[cc->chunk[slot]].slot = -1;
+	cc->chunk[slot] = c;
+	cc->frame[slot] = gl.frame;
+	st->chunks[c].slot = slot;
+	size_t i = c % st->w, j = c / st->w;
+	glBindFramebuffer(GL_FRAMEBUFFER, cc->fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+			GL_TEXTURE_2D, cc->tex[slot], 0);
+	glPushAttrib(GL_VIEWPORT_BIT | GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT);
+	glViewport(0, 0, side, side);
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	/* row 0 of the texture is the top of the chunk */
+	glOrtho(i*side, (i + 1)*side, j*side, (j + 1)*side, -1, 1);
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+	/* transparent texels of a tile must not cover those below it */
+	glEnable(GL_ALPHA_TEST);
+	glAlphaFunc(GL_GREATER, 0);
+	glClearColor(0, 0, 0, 0);
+	glClear(GL_COLOR_BUFFER_BIT);
+	if (gl_static_arrays_begin(st)) {
+		gl_static_draw_around(st, i, j);
+		gl_static_arrays_end(st);
+	}
+	glPopMatrix();
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+	glPopAttrib();
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	return slot;
+}
+void gl_cache_init(struct gl_static *st)
+{
+	struct gl_chunk_cache *cc = &st->cache;
+	const GLsizei side = CHUNK_BLOCKS * BLOCK_SIZE;
+	size_t nfilled = 0;
+	for (size_t c = 0; c < st->w * st->h; ++c)
+		nfilled += st->chunks[c].filled;
+	cc->nslots = 0;
+	if (nfilled == 0 || !gl_has(3, 0, "GL_ARB_framebuffer_object"))
+		return;
+	cc->nslots = nfilled < CHUNK_CACHE ? nfilled : CHUNK_CACHE;
+	glGenFramebuffers(1, &cc->fbo);
+	glGenTextures(cc->nslots, cc->tex);
+	for (size_t s = 0; s < cc->nslots; ++s) {
+		gl_bind_texno(cc->tex[s]);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, side, side, 0,
+				GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+				GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER,
+				GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+		cc->chunk[s] = -1;
+		cc->frame[s] = 0;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, cc->fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+			GL_TEXTURE_2D, cc->tex[0], 0);
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		gl_cache_free(cc);
+		return;
+	}
+	for (size_t c = 0, s = 0; c < st->w * st->h && s < cc->nslots; ++c)
+		if (st->chunks[c].filled) {
+			gl_cache_bake(st, c);
+			++s;
+		}
+}
+
+/* draws the static tiles which intersect the rectangle (x1, y1), (x2, y2) */
+void gl_draw_static(double x1, double y1, double x2, double y2)
+{
+	struct gl_static *st = &gl.st;
+	struct gl_chunk_cache *cc = &st->cache;
+	const double side = CHUNK_BLOCKS * BLOCK_SIZE;
+	if (!cc->nslots) {
+		if (!gl_static_arrays_begin(st))
+			return;
+		for (size_t j = fmax(0, y1 - side) / side;
+				j < st->h && j * side < y2; ++j)
+			for (size_t i = fmax(0, x1 - side) / side;
+					i < st->w && i * side < x2; ++i) {
+				const struct gl_chunk *c =
+					&st->chunks[j*st->w + i];
+				if (c->count == 0 ||
+				    c->box.x >= x2 || c->box.x + c->box.w <= x1 ||
+				    c->box.y >= y2 || c->box.y + c->box.h <= y1)
+					continue;
+				glDrawArrays(GL_QUADS, c->first, c->count);
+			}
+		gl_static_arrays_end(st);
+		return;
+	}
+	/* transparent texels must not hide dynamic tiles behind them */
+	glEnable(GL_ALPHA_TEST);
+	glAlphaFunc(GL_GREATER, 0);
+	for (size_t j = y1 / side; j < st->h && j * side < y2; ++j)
+		for (size_t i = x1 / side; i < st->w && i * side < x2; ++i) {
+			struct gl_chunk *c = &st->chunks[j*st->w + i];
+			if (!c->filled)
+				continue;
+			int slot = c->slot;
+			if (slot < 0)
+				slot = gl_cache_bake(st, j*st->w + i);
+			if (slot < 0) {
+				/* more chunks in view than the cache holds */
+				if (gl_static_arrays_begin(st)) {
+					gl_static_draw_around(st, i, j);
+					gl_static_arrays_end(st);
+				}
+				continue;
+			}
+			cc->frame[slot] = gl.frame;
+			gl_bind_texno(cc->tex[slot]);
+			glBegin(GL_QUADS);
+			glTexCoord2f(0, 0);
+			glVertex3d(i*side, j*side, 0);
+			glTexCoord2f(0, 1);
+			glVertex3d(i*side, (j + 1)*side, 0);
+			glTexCoord2f(1, 1);
+			glVertex3d((i + 1)*side, (j + 1)*side, 0);
+			glTexCoord2f(1, 0);
+			glVertex3d((i + 1)*side, j*side, 0);
+			glEnd();
+		}
+	glDisable(GL_ALPHA_TEST);
+	gl_bind_texture(gl.ttm);
+}
+/* ==================== /Static geometry ==================== */
+
+/* ==================== Streamed geometry ==================== */
+/* Sprites which change from frame to frame are collected in memory during the
+ * frame and sent in one piece at its end. The vertex buffer is used as a
+ * ring: each frame's batch follows the previous one, and when it does not
+ * fit, the buffer is orphaned so that the driver gives it new storage
+ * instead of waiting for draws still reading the old one. */
+void gl_stream_init(struct gl_stream *s)
+{
+	s->n = s->size = 0;
+	s->data = NULL;
+	s->dz = 0;
+	s->bytes = 0;
+	s->vbo = 0;
+	s->cap = STREAM_VERTICES;
+	s->head = 0;
+	if (gl_has(1, 5, NULL)) {
+		glGenBuffers(1, &s->vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, s->vbo);
+		glBufferData(GL_ARRAY_BUFFER,
+				s->cap * STREAM_FLOATS * sizeof(GLfloat),
+				NULL, GL_STREAM_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+}
+void gl_stream_free(struct gl_stream *s)
+{
+	if (s->vbo)
+		glDeleteBuffers(1, &s->vbo);
+	free(s->data);
+	s->vbo = 0;
+	s->data = NULL;
+	s->n = s->size = 0;
+}
+/* returns room for n more vertices of the current batch */
+GLfloat *gl_stream_alloc(struct gl_stream *s, size_t n)
+{
+	if (s->n + n > s->size) {
+		s->size = s->size ? 2 * s->size : STREAM_VERTICES;
+		if (s->size < s->n + n)
+			s->size = s->n + n;
+		s->data = realloc(s->data,
+				s->size * STREAM_FLOATS * sizeof(*s->data));
+	}
+	GLfloat *v = s->data + s->n * STREAM_FLOATS;
+	s->n += n;
+	return v;
+}
+/* uploads the current batch and draws it as quads with one call */
+void gl_stream_flush(struct gl_stream *s)
+{
+	const size_t vsize = STREAM_FLOATS * sizeof(GLfloat);
+	if (s->n == 0)
+		return;
+	GLint first = 0;
+	if (s->vbo) {
+		glBindBuffer(GL_ARRAY_BUFFER, s->vbo);
+		if (s->head + s->n > s->cap) {
+			if (s->n > s->cap)
+				s->cap = 2 * s->n;
+			glBufferData(GL_ARRAY_BUFFER, s->cap * vsize, NULL,
+					GL_STREAM_DRAW);
+			s->head = 0;
+		}
+		glBufferSubData(GL_ARRAY_BUFFER, s->head * vsize,
+				s->n * vsize, s->data);
+		first = s->head;
+		s->head += s->n;
+		glVertexPointer(3, GL_FLOAT, vsize, (const GLvoid*)0);
+		glTexCoordPointer(2, GL_FLOAT, vsize,
+				(const GLvoid*)(3 * sizeof(GLfloat)));
+		glColorPointer(4, GL_UNSIGNED_BYTE, vsize,
+				(const GLvoid*)(VERTEX_FLOATS * sizeof(GLfloat)));
+	} else {
+		glVertexPointer(3, GL_FLOAT, vsize, s->data);
+		glTexCoordPointer(2, GL_FLOAT, vsize, s->data + 3);
+		glColorPointer(4, GL_UNSIGNED_BYTE, vsize,
+				s->data + VERTEX_FLOATS);
+	}
+	s->bytes += s->n * vsize;
+	gl_bind_texture(gl.ttm);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	glDrawArrays(GL_QUADS, first, s->n);
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	/* the colour array leaves the current colour undefined */
+	glColor4f(1, 1, 1, 1);
+	if (s->vbo)
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	s->n = 0;
+}
+/* ==================== /Streamed geometry ==================== */
+
 void gl_dispatch_drawing(const struct tile *tile)
 {
-	switch (tile->type) {
-	case Transparent:
-		break;
-	case Simple:
-		gl_draw_simple_tile(tile);
-		break;
-	case Blink:
-		gl_draw_blinking_tile(tile);
+	struct tile frame;
+	if (!tile_shown(tile, gl.l->time))
+		return;
+	if (tile->anim != NotAnimated) {
+		frame = *tile;
+		frame.tex_x = anim_tex_x(tile, gl.l->time);
+		tile = &frame;
 	}
+	gl_draw_sprite(tile->x, tile->y, tile);
 }
 
+/* ==================== Level of detail ==================== */
+/* Zoomed out, walking the blocks in view and drawing their tiles costs more
+ * the more of the level is in view. Instead the static tiles of the whole
+ * level are baked once by the software renderer at LOD_SCALE (or less, if the
+ * texture would not fit) into a mipmapped texture, halved level by level, and
+ * the level is drawn as one quad; the GPU picks the pyramid level. The
+ * dynamic objects are reduced to markers of the ship, the airports which
+ * still have cargo and the gates. The padding of the power of two texture is
+ * the clear colour, so that it does not bleed into the level's edges. */
+void gl_lod_init(const SDL_Surface *ts)
+{
+	const struct cgl *l = gl.l;
+	GLint max_size;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+	int lw = l->width * BLOCK_SIZE,
+	    lh = l->height * BLOCK_SIZE,
+	    k = ceil(1 / LOD_SCALE),
+	    tw, th;
+	for (;; k *= 2) {
+		tw = 1 << (int)ceil(log2((lw + k - 1) / k));
+		th = 1 << (int)ceil(log2((lh + k - 1) / k));
+		if (tw <= max_size && th <= max_size)
+			break;
+	}
+	struct sw_image im;
+	sw_image_init(&im, tw, th);
+	for (size_t i = 0; i < (size_t)tw * th; ++i) {
+		uint8_t *p = im.px + 4 * i;
+		p[0] = p[1] = p[2] = 26, p[3] = 255;
+	}
+	sw_render_reduced(l, ts, k, &im);
+	glGenTextures(1, &gl.lod.tex);
+	glBindTexture(GL_TEXTURE_2D, gl.lod.tex);
+	gl.curtex = gl.lod.tex;
+	for (int i = 0; ; ++i) {
+		glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA, im.w, im.h, 0,
+				GL_RGBA, GL_UNSIGNED_BYTE, im.px);
+		if (im.w == 1 && im.h == 1)
+			break;
+		sw_image_halve(&im);
+	}
+	sw_image_free(&im);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+			GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+	gl.lod.u = (double)lw / k / tw;
+	gl.lod.v = (double)lh / k / th;
+}
+/* a square of LOD_MARK window pixels centered at (x, y) */
+static inline void gl_lod_mark(double x, double y)
+{
+	double r = LOD_MARK / 2.0 / gl.cam.scale;
+	glVertex3d(x - r, y - r, 1);
+	glVertex3d(x - r, y + r, 1);
+	glVertex3d(x + r, y + r, 1);
+	glVertex3d(x + r, y - r, 1);
+}
+static inline void gl_lod_mark_tile(const struct tile *t)
+{
+	gl_lod_mark(t->x + t->w/2.0, t->y + t->h/2.0);
+}
+/* in the colours of the minimap */
+void gl_draw_lod_marks(void)
+{
+	const struct cgl *l = gl.l;
+	glDisable(GL_TEXTURE_2D);
+	glBegin(GL_QUADS);
+	glColor4f(1, 0.86, 0.25, 1);
+	for (size_t i = 0; i < l->nairports; ++i)
+		if (l->airports[i].type != Homebase &&
+				l->airports[i].num_cargo)
+			gl_lod_mark_tile(l->airports[i].base);
+	for (size_t i = 0; i < l->ngates; ++i) {
+		const struct gate *g = &l->gates[i];
+		if (g->len >= g->max_len)
+			glColor4f(0.9, 0.19, 0.19, 1);
+		else
+			glColor4f(0.25, 0.86, 0.25, 1);
+		gl_lod_mark_tile(g->base[0]);
+	}
+	for (size_t i = 0; i < l->nlgates; ++i) {
+		const struct lgate *g = &l->lgates[i];
+		if (g->len >= g->max_len)
+			glColor4f(0.9, 0.19, 0.19, 1);
+		else
+			glColor4f(0.25, 0.86, 0.25, 1);
+		gl_lod_mark_tile(g->base[0]);
+	}
+	if (!l->ship->dead) {
+		glColor4f(1, 1, 1, 1);
+		gl_lod_mark(l->ship->x + SHIP_W/2.0, l->ship->y + SHIP_H/2.0);
+	}
+	glEnd();
+	glColor4f(1, 1, 1, 1);
+	glEnable(GL_TEXTURE_2D);
+}
+void gl_draw_lod(void)
+{
+	double w = gl.l->width * BLOCK_SIZE,
+	       h = gl.l->height * BLOCK_SIZE;
+	gl_bind_texno(gl.lod.tex);
+	glBegin(GL_QUADS);
+	glTexCoord2f(0, 0);
+	glVertex3d(0, 0, 0);
+	glTexCoord2f(0, gl.lod.v);
+	glVertex3d(0, h, 0);
+	glTexCoord2f(gl.lod.u, gl.lod.v);
+	glVertex3d(w, h, 0);
+	glTexCoord2f(gl.lod.u, 0);
+	glVertex3d(w, 0, 0);
+	glEnd();
+	gl_draw_lod_marks();
+}
+/* ==================== /Level of detail ==================== */
+
 /* ==================== General graphics ==================== */
 
 void gl_draw_osd(double time)
 {
+	PROF_BEGIN(ProfOsdStep);
 	osd_step(time);
+	PROF_END(ProfOsdStep);
+	PROF_BEGIN(ProfOsdDraw);
 	osd_draw();
+	PROF_END(ProfOsdDraw);
 }
 void gl_cam_step(double dt)
 {
@@ -178,16 +889,103 @@ void gl_cam_step(double dt)
 	if (abs(gl.cam.y - dest_y) > 2)
 		gl.cam.y += (dest_y - gl.cam.y) * CAM_SPEED * dt;
 }
+/* Zooms the camera by the factor. The scale is kept between the one at which
+ * the whole level fits in the window and CAM_MAX_SCALE. */
+void gl_zoom(double factor)
+{
+	double fit = fmin(gl.win_w / (gl.l->width * BLOCK_SIZE),
+			gl.win_h / (gl.l->height * BLOCK_SIZE));
+	gl.cam.scale = fmax(fmin(1, fit),
+			fmin(CAM_MAX_SCALE, gl.cam.scale * factor));
+}
 void gl_update_window(double time)
 {
+	extern void gl_timer_begin(struct gl_frame_timer*),
+		    gl_timer_end(struct gl_frame_timer*, uint64_t);
 	double dt = time - gl.time;
 	gl_cam_step(dt);
+	gl_timer_begin(&gl.ft);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	glLoadIdentity();
+	PROF_BEGIN(ProfScene);
 	gl_draw_scene();
+	PROF_END(ProfScene);
 	glLoadIdentity();
 	glTranslated(0, 0, 2);
 	gl_draw_osd(time);
+	if (gl.ft.gpu)
+		glEndQuery(GL_TIME_ELAPSED);
+	uint64_t swap = prof_now();
+	PROF_BEGIN(ProfSwap);
 	SDL_GL_SwapBuffers();
+	PROF_END(ProfSwap);
+	gl_timer_end(&gl.ft, swap);
 	gl.time = time;
 }
+
+/* ==================== Frame timing ==================== */
+/* The parts of every frame go to the frame histograms. GPU time comes from
+ * timer queries, whose results are only read GPU_QUERIES frames later, so as
+ * not to wait for the GPU; a frame is recorded when its result is in. */
+void gl_timer_init(struct gl_frame_timer *ft)
+{
+	ft->gpu = gl_has(3, 3, "GL_ARB_timer_query");
+	if (ft->gpu)
+		glGenQueries(GPU_QUERIES, ft->query);
+	for (size_t i = 0; i < GPU_QUERIES; ++i)
+		ft->pending[i] = 0;
+	ft->begin = prof_now();
+}
+/* records the frame measured in the slot, waiting for its GPU time */
+void gl_timer_collect(struct gl_frame_timer *ft, size_t slot)
+{
+	GLuint64 ns;
+	glGetQueryObjectui64v(ft->query[slot], GL_QUERY_RESULT, &ns);
+	ft->ns[slot][FrameGpu] = ns;
+	prof_frame(ft->frame[slot], ft->ns[slot]);
+	ft->pending[slot] = 0;
+}
+void gl_timer_free(struct gl_frame_timer *ft)
+{
+	if (!ft->gpu)
+		return;
+	/* oldest first: the next slot to be used holds the oldest frame */
+	for (size_t i = 0; i < GPU_QUERIES; ++i) {
+		size_t slot = (gl.frame + i) % GPU_QUERIES;
+		if (ft->pending[slot])
+			gl_timer_collect(ft, slot);
+	}
+	glDeleteQueries(GPU_QUERIES, ft->query);
+	ft->gpu = 0;
+}
+/* marks the start of a frame, before the simulation is advanced */
+void gl_frame_begin(void)
+{
+	gl.ft.begin = prof_now();
+}
+void gl_timer_begin(struct gl_frame_timer *ft)
+{
+	size_t slot = gl.frame % GPU_QUERIES;
+	if (!ft->gpu)
+		return;
+	if (ft->pending[slot])
+		gl_timer_collect(ft, slot);
+	glBeginQuery(GL_TIME_ELAPSED, ft->query[slot]);
+}
+/* called after the swap which started at the given time */
+void gl_timer_end(struct gl_frame_timer *ft, uint64_t swap)
+{
+	/* gl_draw_scene has already counted the frame */
+	uint64_t frame = gl.frame - 1;
+	size_t slot = frame % GPU_QUERIES;
+	ft->frame[slot] = frame;
+	ft->ns[slot][FrameCpu] = swap - ft->begin;
+	ft->ns[slot][FrameSwap] = prof_now() - swap;
+	if (ft->gpu) {
+		ft->pending[slot] = 1;
+	} else {
+		ft->ns[slot][FrameGpu] = PROF_NONE;
+		prof_frame(frame, ft->ns[slot]);
+	}
+}
+/* ==================== /Frame timing ==================== */
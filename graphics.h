@@ -22,6 +22,7 @@
 
 #include "cg.h"
 #include "texmgr.h"
+#include "prof.h"
 #include <SDL/SDL.h>
 #include <SDL/SDL_opengl.h>
 
@@ -30,23 +31,136 @@ struct camera {
 	double nx, ny;
 	double scale;
 };
+enum gl_consts {
+	/* side of a chunk of static geometry, in blocks (512 px) */
+	CHUNK_BLOCKS = 16,
+	/* floats per vertex of static geometry: x, y, z, u, v */
+	VERTEX_FLOATS = 5,
+	/* floats per streamed vertex: those above and the colour, as four
+	 * bytes in the place of one more float */
+	STREAM_FLOATS = VERTEX_FLOATS + 1,
+	/* side of the opaque white image sampled by flat streamed quads */
+	WHITE_SIDE = 2,
+	/* most chunks pre-rendered at once, 1 MiB of texture each */
+	CHUNK_CACHE = 32,
+	/* initial size of the ring of streamed vertices */
+	STREAM_VERTICES = 16384,
+	/* frames in flight measured by GPU timer queries */
+	GPU_QUERIES = 4,
+	/* side of the markers drawn over the baked level, in window pixels */
+	LOD_MARK = 4
+};
+/* The static tiles whose origin lies in a square of CHUNK_BLOCKS blocks,
+ * stored as a contiguous range of quads in the vertex buffer */
+struct gl_chunk {
+	GLint first;
+	GLsizei count;
+	/* bounding box of the tiles, which may stick out of the chunk */
+	struct rect box;
+	/* whether any static tile reaches into the chunk */
+	int filled;
+	/* slot of the pre-rendered chunk in the cache, -1 if none */
+	int slot;
+};
+/* Textures holding chunks pre-rendered through a framebuffer object */
+struct gl_chunk_cache {
+	/* 0 if framebuffer objects are not supported */
+	size_t nslots;
+	GLuint fbo;
+	GLuint tex[CHUNK_CACHE];
+	/* chunk held by each slot (-1 if none) and the frame it was last
+	 * drawn in */
+	long chunk[CHUNK_CACHE];
+	unsigned int frame[CHUNK_CACHE];
+};
+struct gl_static {
+	/* 0 if vertex buffers are not supported, vertices stay in data then */
+	GLuint vbo;
+	GLfloat *data;
+	size_t w, h;
+	struct gl_chunk *chunks;
+	struct gl_chunk_cache cache;
+};
+/* Vertices of the sprites which change every frame, sent to the GPU once per
+ * frame through a ring in a vertex buffer */
+struct gl_stream {
+	/* the batch of the current frame */
+	GLfloat *data;
+	size_t n, size;
+	/* added to the z of the sprites being put into the batch */
+	double dz;
+	/* 0 if vertex buffers are not supported, the batch is drawn from
+	 * memory then */
+	GLuint vbo;
+	/* capacity of the buffer and the next free vertex in it */
+	size_t cap, head;
+	/* bytes uploaded since the start */
+	uint64_t bytes;
+};
+/* The dynamic tiles of every block, by tile id: those of block (i, j) are
+ * ids[first[j*width + i]] up to ids[first[j*width + i + 1]] */
+struct gl_visible {
+	size_t *first;
+	uint32_t *ids;
+	/* whether a row or a column of blocks holds any dynamic tile */
+	uint8_t *row, *col;
+	/* the frame each tile was last drawn in */
+	unsigned int *drawn;
+};
+/* Timing of the parts of a frame, with the frames whose GPU time is not known
+ * yet kept in slots indexed by frame number */
+struct gl_frame_timer {
+	/* 0 if timer queries are not supported */
+	int gpu;
+	GLuint query[GPU_QUERIES];
+	int pending[GPU_QUERIES];
+	uint64_t frame[GPU_QUERIES];
+	uint64_t ns[GPU_QUERIES][PROF_NPARTS];
+	/* when the current frame started */
+	uint64_t begin;
+};
+/* The static tiles of the whole level baked into a mipmapped texture, drawn
+ * instead of the tiles below LOD_SCALE */
+struct gl_lod {
+	/* 0 if there is none */
+	GLuint tex;
+	/* the part of the texture covered by the level */
+	GLfloat u, v;
+};
 struct glengine {
 	double time;
 	struct texmgr *ttm,
 		      *ftm,
-		      *otm;
+		      *otm,
+		      /* the minimap, NULL if there is none */
+		      *mtm,
+		      /* the white image, in the texture of ttm */
+		      *wtm;
 	struct drect viewport;
 	struct camera cam;
 	double win_w, win_h;
 	struct cgl *l;
 	unsigned int frame;
 	GLuint curtex;
+	struct gl_static st;
+	struct gl_stream stream;
+	struct gl_visible vis;
+	struct gl_frame_timer ft;
+	struct gl_lod lod;
 };
 extern struct glengine gl;
 
-void gl_init(struct cgl*, struct texmgr*, struct texmgr*, struct texmgr*);
+void gl_init(struct cgl*, struct texmgr*, struct texmgr*, struct texmgr*,
+		struct texmgr*, struct texmgr*);
+SDL_Surface *gl_white_image(void);
+void gl_free(void);
+void gl_frame_begin(void);
 void gl_resize_viewport(double, double);
+void gl_set_viewport(double, double, double);
+void gl_cam_step(double);
 void gl_update_window(double);
+void gl_lod_init(const SDL_Surface*);
+void gl_zoom(double);
 
 static inline void gl_bind_texture(struct texmgr *tm)
 {
@@ -56,7 +170,9 @@ static inline void gl_bind_texture(struct texmgr *tm)
 	}
 }
 
-#define BLINK_SPEED 1.8
 #define CAM_SPEED 2
+#define CAM_MAX_SCALE 10
+/* below this scale the level is drawn from the baked pyramid */
+#define LOD_SCALE 0.5
 
 #endif
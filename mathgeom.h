@@ -23,6 +23,7 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <stdint.h>
 
 #define ARRSZ(a) (sizeof(a)/sizeof(*(a)))
 enum dir {
@@ -52,18 +53,43 @@ static inline int min(int a, int b)
 {
 	return a < b ? a : b;
 }
+/* round() without the libm call */
+static inline int iround(double a)
+{
+	return a < 0 ? -(int)(0.5 - a) : (int)(a + 0.5);
+}
 static inline int sgn(double a)
 {
 	return a < 0 ? -1 : a == 0 ? 0 : 1;
 }
-static inline int rand_range(int min_n, int max_n)
+/* xorshift32 - every simulated instance carries its own generator state, so
+ * that many games may be stepped in parallel and replayed from a seed */
+static inline uint32_t rand_next(uint32_t *state)
+{
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *state = x;
+}
+static inline void rand_seed(uint32_t *state, uint32_t seed)
+{
+	/* zero is the only fixed point of xorshift */
+	*state = seed ? seed : 0x9e3779b9;
+}
+/* uniformly distributed in [0, 1] */
+static inline double rand_unit(uint32_t *state)
+{
+	return rand_next(state) / (double)UINT32_MAX;
+}
+static inline int rand_range(uint32_t *state, int min_n, int max_n)
 {
 	assert(min_n <= max_n);
-	return rand() % (max_n - min_n + 1) + min_n;
+	return rand_next(state) % (max_n - min_n + 1) + min_n;
 }
-static inline int rand_sign()
+static inline int rand_sign(uint32_t *state)
 {
-	return 2 * rand_range(0, 1) - 1;
+	return 2 * rand_range(state, 0, 1) - 1;
 }
 
 struct tile;
@@ -73,5 +99,7 @@ void ship_to_tile(const struct ship*, struct tile*);
 int tiles_intersect(const struct tile*, const struct tile*, struct rect*);
 int discrete_rot(double);
 void rect_to_tile(const struct rect*, struct tile*);
+int anim_tex_x(const struct tile*, double);
+int tile_shown(const struct tile*, double);
 
 #endif
@@ -0,0 +1,85 @@
+/* minimap.c - an overview image of a level
+ * Copyright (C) 2026 FreeCG contributors.
+ *
+ * This file is part of FreeCG.
+ *
+ * FreeCG is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FreeCG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FreeCG. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "minimap.h"
+#include "swrender.h"
+#include "gfx.h"
+#include <string.h>
+
+/* The map shows the tiles which never change, drawn once per level by the
+ * software renderer with every square of scale x scale level pixels averaged
+ * into one pixel. Only the markers of the ship, airports and gates move over
+ * it afterwards. */
+
+static const uint8_t minimap_colours[MINIMAP_NMARKS][4] = {
+	[MarkShip]       = {255, 255, 255, 255},
+	[MarkCargo]      = {255, 220,  64, 255},
+	[MarkGateOpen]   = { 64, 220,  64, 255},
+	[MarkGateClosed] = {230,  48,  48, 255}
+};
+
+/* level pixels per pixel of the map */
+int minimap_scale(const struct cgl *l)
+{
+	int w = l->width * BLOCK_SIZE,
+	    h = l->height * BLOCK_SIZE;
+	return max((w + MINIMAP_MAX_W - 1) / MINIMAP_MAX_W,
+			(h + MINIMAP_MAX_H - 1) / MINIMAP_MAX_H);
+}
+void minimap_size(const struct cgl *l, int *w, int *h)
+{
+	int k = minimap_scale(l);
+	*w = (l->width * BLOCK_SIZE + k - 1) / k;
+	*h = (l->height * BLOCK_SIZE + k - 1) / k;
+}
+/* the map with the marker colours under it, ts is the tileset as returned by
+ * sw_tileset */
+SDL_Surface *minimap_render(const struct cgl *l, const SDL_Surface *ts)
+{
+	int k = minimap_scale(l),
+	    w, h;
+	minimap_size(l, &w, &h);
+	SDL_Surface *map = SDL_CreateRGBSurface(0,
+			max(w, MINIMAP_NMARKS * MINIMAP_MARK),
+			h + MINIMAP_MARK, 32, RMASK, GMASK, BMASK, AMASK);
+	if (!map)
+		return NULL;
+	SDL_SetAlpha(map, 0, 255);
+	if (SDL_MUSTLOCK(map))
+		SDL_LockSurface(map);
+	memset(map->pixels, 0, map->h * map->pitch);
+	/* 32 bit surfaces have no padding, so the pixels are an sw_image */
+	struct sw_image im = {
+		.w = map->w,
+		.h = map->h,
+		.px = map->pixels
+	};
+	sw_clip(&im, NULL);
+	sw_render_reduced(l, ts, k, &im);
+	for (int m = 0; m < MINIMAP_NMARKS; ++m)
+		for (int y = h; y < h + MINIMAP_MARK; ++y) {
+			uint8_t *dst = (uint8_t*)map->pixels + y * map->pitch +
+				4 * m * MINIMAP_MARK;
+			for (int x = 0; x < MINIMAP_MARK; ++x, dst += 4)
+				memcpy(dst, minimap_colours[m], 4);
+		}
+	if (SDL_MUSTLOCK(map))
+		SDL_UnlockSurface(map);
+	return map;
+}
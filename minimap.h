@@ -0,0 +1,47 @@
+/* minimap.h - an overview image of a level
+ * Copyright (C) 2026 FreeCG contributors.
+ *
+ * This file is part of FreeCG.
+ *
+ * FreeCG is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FreeCG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FreeCG. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MINIMAP_H
+#define MINIMAP_H
+
+#include "cg.h"
+#include <SDL/SDL.h>
+
+enum minimap_consts {
+	/* largest size of the map */
+	MINIMAP_MAX_W = 160,
+	MINIMAP_MAX_H = 120,
+	/* side of a marker */
+	MINIMAP_MARK = 3
+};
+/* Markers are drawn from squares of colour kept in the row under the map, in
+ * this order */
+enum minimap_mark {
+	MarkShip = 0,
+	MarkCargo,
+	MarkGateOpen,
+	MarkGateClosed,
+	MINIMAP_NMARKS
+};
+
+int minimap_scale(const struct cgl*);
+void minimap_size(const struct cgl*, int*, int*);
+SDL_Surface *minimap_render(const struct cgl*, const SDL_Surface*);
+
+#endif
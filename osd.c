@@ -20,7 +20,10 @@
 
 #include "osd.h"
 #include "graphics.h"
+#include "minimap.h"
 #include <math.h>
+#include <stdio.h>
+#include <string.h>
 
 static struct cg_osd osd;
 
@@ -124,8 +127,35 @@ void osd_timer_init(struct osd_timer *t, struct osd_element *container, int w)
 	o_img(bcenter, gl.otm, 1.0,  8, 81, 1, 24);
 	o_img(bright,  gl.otm, 1.0, 13, 81, 8, 24);
 }
+void osd_minimap_init(struct osd_minimap *m, struct osd_element *map)
+{
+	const struct cgl *l = gl.l;
+	int w, h;
+	m->map = map;
+	if (!gl.mtm) {
+		map->tr = TransparentSubtree;
+		m->nmarks = 0;
+		return;
+	}
+	m->scale = minimap_scale(l);
+	minimap_size(l, &w, &h);
+	o_dim(map, w, h, Opaque);
+	o_img(map, gl.mtm, 0.8, 0, 0, w, h);
+	/* airports and gates first, so that the ship is drawn over them */
+	m->nmarks = l->nairports + l->ngates + l->nlgates + 1;
+	osdlib_make_children(map, m->nmarks, 0);
+	m->marks = map->ch;
+	for (size_t i = 0; i < m->nmarks; ++i) {
+		o_set(&m->marks[i], NULL, pad(Begin,0), pad(Begin,0),
+				MINIMAP_MARK, MINIMAP_MARK, TransparentElement);
+		o_img(&m->marks[i], gl.mtm, 1.0, 0, h,
+				MINIMAP_MARK, MINIMAP_MARK);
+		m->marks[i].z = 0.01;
+	}
+}
 void osd_init()
 {
+	extern void osd_update_all();
 	const struct osdlib_font f = {
 		.tm = gl.ftm,
 		.w  = 16,
@@ -136,11 +166,13 @@ void osd_init()
 	};
 	osd.font = f;
 	osd.visible = 0;
-	struct osd_element *orect, *opanel, *otimer, *ogameover, *ovictory;
+	struct osd_element *orect, *opanel, *otimer, *ospeed, *ominimap,
+			   *ogameover, *ovictory;
 	osd.layer = calloc(1, sizeof(*osd.layer));
 	osdlib_init(osd.layer, gl.win_w, gl.win_h);
-	osdlib_make_children(osd.layer->root, 5, 1,
-		&orect, &opanel, &otimer, &ogameover, &ovictory);
+	osdlib_make_children(osd.layer->root, 7, 1,
+		&orect, &opanel, &otimer, &ospeed, &ominimap,
+		&ogameover, &ovictory);
 	osd.shipinfo.container = orect;
 	osd.panel.container = opanel;
 	osd.timer.container = otimer;
@@ -173,6 +205,13 @@ void osd_init()
 	/* timer */
 	o_pos(otimer, NULL, center(), pad(T,-32));
 	osd_timer_init(&osd.timer, otimer, 96);
+	/* speed */
+	o_pos(ospeed, NULL, pad(End,8), pad(Begin,8));
+	ospeed->tr = TransparentSubtree;
+	osd.speed.label = ospeed;
+	/* minimap, hidden to the left */
+	osd_minimap_init(&osd.minimap, ominimap);
+	o_pos(ominimap, NULL, pad(Begin,-ominimap->w), pad(Begin,8));
 	osd_show();
 
 	/* DEPRECATED (labels will go to menu) */
@@ -191,6 +230,7 @@ void osd_init()
 	osd.victory = ovictory;
 	osd.gameover = ogameover;
 	/* /DEPRECATED */
+	osd_update_all();
 }
 
 void osd_fuel_step(struct osd_fuel *f, double fuel)
@@ -226,10 +266,10 @@ void osd_velocity_step(struct osd_velocity *v, double vx, double vy,
 	v->mxbar2->x.v = fmin(32, fmax(-32, -max_vx/3));
 	v->mybar->y.v  = fmin(32, fmax(-32,  max_vy/3));
 }
-void osd_keys_step(struct osd_keys *k, const int *keys)
+void osd_keys_step(struct osd_keys *k)
 {
 	for (size_t i = 0; i < 4; ++i) {
-		if (!keys[i]) {
+		if (!k->held[i]) {
 			k->keys[i].a = 0.2;
 			k->keys[i].tex_x = 256;
 		} else {
@@ -282,6 +322,53 @@ void osd_life_step(struct osd_life *l, size_t life)
 		}
 	l->old_life = life;
 }
+/* puts a marker at (x, y) of the level, a negative mark hides it */
+static inline void osd_minimap_mark(const struct osd_minimap *m,
+		struct osd_element *e, double x, double y, int mark)
+{
+	if (mark < 0) {
+		e->tr = TransparentElement;
+		return;
+	}
+	e->tr = Opaque;
+	e->x.v = x / m->scale - MINIMAP_MARK/2.0;
+	e->y.v = y / m->scale - MINIMAP_MARK/2.0;
+	e->tex_x = mark * MINIMAP_MARK;
+}
+static inline void osd_minimap_mark_tile(const struct osd_minimap *m,
+		struct osd_element *e, const struct tile *t, int mark)
+{
+	osd_minimap_mark(m, e, t->x + t->w/2.0, t->y + t->h/2.0, mark);
+}
+/* the map itself never changes, only its markers are moved */
+void osd_minimap_step(struct osd_minimap *m)
+{
+	const struct cgl *l = gl.l;
+	struct osd_element *e = m->marks;
+	if (!m->nmarks)
+		return;
+	for (size_t i = 0; i < l->nairports; ++i) {
+		const struct airport *a = &l->airports[i];
+		osd_minimap_mark_tile(m, e++, a->base,
+				a->type != Homebase && a->num_cargo ?
+				MarkCargo : -1);
+	}
+	for (size_t i = 0; i < l->ngates; ++i) {
+		const struct gate *g = &l->gates[i];
+		osd_minimap_mark_tile(m, e++, g->base[0],
+				g->len >= g->max_len ?
+				MarkGateClosed : MarkGateOpen);
+	}
+	for (size_t i = 0; i < l->nlgates; ++i) {
+		const struct lgate *g = &l->lgates[i];
+		osd_minimap_mark_tile(m, e++, g->base[0],
+				g->len >= g->max_len ?
+				MarkGateClosed : MarkGateOpen);
+	}
+	osd_minimap_mark(m, e, l->ship->x + SHIP_W/2.0,
+			l->ship->y + SHIP_H/2.0,
+			l->ship->dead ? -1 : MarkShip);
+}
 void osd_timer_step(struct osd_timer *t, double time)
 {
 	char time_str[8];
@@ -290,33 +377,128 @@ void osd_timer_step(struct osd_timer *t, double time)
 	sprintf(time_str, "%.2d:%.2d", min, sec);
 	o_txt(t->time, &osd.font, time_str);
 }
-void osd_step(double time)
+/* Shows the effective speed of the simulation relative to real time, or that
+ * it is paused. The label is hidden at normal speed. */
+void osd_set_speed(double speed, int paused)
+{
+	char text[sizeof(osd.speed.text)] = "";
+	if (paused)
+		strcpy(text, "PAUSED");
+	else if (fabs(speed - 1) >= 0.05)
+		sprintf(text, "X%.2g", speed);
+	if (strcmp(text, osd.speed.text) == 0)
+		return;
+	strcpy(osd.speed.text, text);
+	if (text[0] == '\0')
+		osd.speed.label->tr = TransparentSubtree;
+	else
+		o_txt(osd.speed.label, &osd.font, text);
+}
+/* ==================== Event handling ==================== */
+void osd_update_lfreight()
 {
-	struct ship *ship = gl.l->ship;
-	osd_fuel_step(&osd.shipinfo.fuel, ship->fuel);
-	osd_velocity_step(&osd.shipinfo.velocity, ship->vx, ship->vy,
-			ship->max_vx, ship->max_vy);
-	osd_keys_step(&osd.shipinfo.keys, ship->keys);
 	size_t nfreight = cg_freight_remaining(gl.l);
 	struct freight freight[nfreight];
 	cg_get_freight_airports(gl.l, freight);
 	osd_freight_step(&osd.panel.lfreight, freight, nfreight);
+}
+void osd_update_sfreight()
+{
+	struct ship *ship = gl.l->ship;
 	osd.panel.sfreight.max_freight = ship->max_freight;
 	osd_freight_step(&osd.panel.sfreight, ship->freight, ship->num_freight);
+}
+void osd_update_hbfreight()
+{
 	struct airport *hb = gl.l->hb;
 	osd_freight_step(&osd.panel.hbfreight, hb->c.freight, hb->num_cargo);
+}
+void osd_update_life()
+{
 	osd_life_step(&osd.panel.life, max(0, gl.l->ship->life));
-	osd_timer_step(&osd.timer, time);
+}
+/* reads the keys held by the ship, for changes which are not events */
+void osd_update_keys()
+{
+	for (size_t i = 0; i < 4; ++i)
+		osd.shipinfo.keys.held[i] = gl.l->ship->keys[i];
+}
+/* brings the OSD up to date with everything, used before the first event */
+void osd_update_all()
+{
+	osd_update_keys();
+	osd_update_lfreight();
+	osd_update_sfreight();
+	osd_update_hbfreight();
+	osd_update_life();
 	if (gl.l->status == Victory)
 		osd.victory->tr = Opaque;
 	if (gl.l->status == Lost)
 		osd.gameover->tr = Opaque;
+	osd.event_cursor = gl.l->nevents;
+}
+void osd_handle_event(const struct cg_event *e)
+{
+	switch (e->type) {
+	case EvCargoLoaded:
+	case EvCargoReturned:
+		osd_update_lfreight();
+		osd_update_sfreight();
+		break;
+	case EvCargoUnloaded:
+		osd_update_sfreight();
+		osd_update_hbfreight();
+		break;
+	case EvKeyPickup:
+		osd.shipinfo.keys.held[e->arg] = gl.l->ship->keys[e->arg];
+		break;
+	case EvExtraPickup:
+		osd_update_sfreight();
+		osd_update_life();
+		break;
+	case EvShipRestarted:
+		osd_update_life();
+		break;
+	case EvVictory:
+		osd.victory->tr = Opaque;
+		break;
+	case EvLost:
+		osd_update_life();
+		osd.gameover->tr = Opaque;
+		break;
+	default:
+		break;
+	}
+}
+/* ==================== /Event handling ==================== */
+
+void osd_step(double time)
+{
+	struct ship *ship = gl.l->ship;
+	const struct cg_event *e;
+	/* events lost off the ring cannot be replayed, the state is read
+	 * again instead */
+	if (gl.l->nevents - osd.event_cursor > CG_EVENT_RING)
+		osd_update_all();
+	while ((e = cg_next_event(gl.l, &osd.event_cursor)))
+		osd_handle_event(e);
+	/* fuel and velocity change continuously, they are read directly */
+	osd_fuel_step(&osd.shipinfo.fuel, ship->fuel);
+	osd_velocity_step(&osd.shipinfo.velocity, ship->vx, ship->vy,
+			ship->max_vx, ship->max_vy);
+	osd_keys_step(&osd.shipinfo.keys);
+	osd_timer_step(&osd.timer, gl.l->time);
+	osd_minimap_step(&osd.minimap);
 	osdlib_step(osd.layer, time);
 }
 void osd_draw()
 {
 	osdlib_draw(osd.layer);
 }
+void osd_walk(osd_visit_fn fn, void *arg)
+{
+	osdlib_walk(osd.layer, fn, arg);
+}
 
 void osd_free()
 {
@@ -334,6 +516,9 @@ void osd_show()
 	a = anim(Abs, Abs, &osd.timer.container->y.v, ease_atan,
 			-osd.timer.container->h, 0, t+0.25, t+0.75);
 	osdlib_add_animation(osd.layer, a);
+	a = anim(Abs, Abs, &osd.minimap.map->x.v, ease_atan,
+			-osd.minimap.map->w, 8, t+0.25, t+0.75);
+	osdlib_add_animation(osd.layer, a);
 	osd.visible = 1;
 }
 void osd_hide()
@@ -348,6 +533,9 @@ void osd_hide()
 	a = anim(Abs, Abs, &osd.timer.container->y.v, ease_atan,
 			0, -osd.timer.container->h, t, t+0.5);
 	osdlib_add_animation(osd.layer, a);
+	a = anim(Abs, Abs, &osd.minimap.map->x.v, ease_atan,
+			8, -osd.minimap.map->w, t, t+0.5);
+	osdlib_add_animation(osd.layer, a);
 	osd.visible = 0;
 }
 void osd_toggle()
@@ -21,6 +21,7 @@
 #define OSD_H
 
 #include "osdlib.h"
+#include <stdint.h>
 
 struct osd_fuel {
 	size_t old_nfuel;
@@ -35,6 +36,8 @@ struct osd_velocity {
 };
 struct osd_keys {
 	struct osd_element *keys;
+	/* keys held by the ship, as reported by events */
+	int held[4];
 };
 struct osd_shipinfo {
 	struct osd_element *container;
@@ -64,6 +67,20 @@ struct osd_timer {
 	struct osd_element *container;
 	struct osd_element *time;
 };
+/* the overview of the level with markers of the ship, the airports which
+ * still have cargo and the gates */
+struct osd_minimap {
+	struct osd_element *map;
+	size_t nmarks;
+	struct osd_element *marks;
+	/* level pixels per pixel of the map */
+	int scale;
+};
+/* simulation speed, shown only when it is not the normal one */
+struct osd_speed {
+	struct osd_element *label;
+	char text[16];
+};
 struct cg_osd {
 	int visible;
 	struct osd_layer *layer;
@@ -72,6 +89,10 @@ struct cg_osd {
 	struct osd_shipinfo shipinfo;
 	struct osd_panel    panel;
 	struct osd_timer    timer;
+	struct osd_speed    speed;
+	struct osd_minimap  minimap;
+	/* position in the level's event stream */
+	uint32_t event_cursor;
 
 	/* deprecated */
 	struct osd_element *victory,
@@ -81,9 +102,12 @@ struct cg_osd {
 void osd_init();
 void osd_step();
 void osd_draw();
+void osd_walk(osd_visit_fn, void*);
 void osd_free();
 void osd_show();
 void osd_hide();
 void osd_toggle();
+void osd_set_speed(double, int);
+void osd_update_keys();
 
 #endif
@@ -182,31 +182,16 @@ void osdlib_count_absolute(struct osd_layer *l, struct osd_element *e)
 	e->rz = pz + e->z/100;
 	/* FIXME: consider a */
 }
-void osdlib_draw_rec(struct osd_layer *l, struct osd_element *e)
+void osdlib_walk_rec(struct osd_layer *l, struct osd_element *e,
+		osd_visit_fn fn, void *arg)
 {
 	osdlib_count_absolute(l, e);
-	if (e->tr == Opaque) {
-		gl_bind_texture(e->t);
-		glBegin(GL_QUADS);
-		glColor4f(1, 1, 1, e->a);
-		tm_coord_tl(e->t, e->tex_x, e->tex_y,
-				e->tex_w, e->tex_h);
-		glVertex3d(e->rx, e->ry, e->rz);
-		tm_coord_bl(e->t, e->tex_x, e->tex_y,
-				e->tex_w, e->tex_h);
-		glVertex3d(e->rx, e->ry + e->rh, e->rz);
-		tm_coord_br(e->t, e->tex_x, e->tex_y,
-				e->tex_w, e->tex_h);
-		glVertex3d(e->rx + e->rw, e->ry + e->rh, e->rz);
-		tm_coord_tr(e->t, e->tex_x, e->tex_y,
-				e->tex_w, e->tex_h);
-		glVertex3d(e->rx + e->rw, e->ry, e->rz);
-		glEnd();
-	}
+	if (e->tr == Opaque)
+		fn(e, arg);
 	if (e->tr != TransparentSubtree) {
 		/* recurse into the children */
 		for (size_t i = 0; i < e->nch; ++i)
-			osdlib_draw_rec(l, &e->ch[i]);
+			osdlib_walk_rec(l, &e->ch[i], fn, arg);
 	}
 }
 void mark_as_unvisited(struct osd_element *e)
@@ -215,10 +200,36 @@ void mark_as_unvisited(struct osd_element *e)
 	for (size_t i = 0; i < e->nch; ++i)
 		mark_as_unvisited(&e->ch[i]);
 }
-void osdlib_draw(struct osd_layer *l)
+/* calls fn for every visible element, in drawing order, with its absolute
+ * position computed */
+void osdlib_walk(struct osd_layer *l, osd_visit_fn fn, void *arg)
 {
 	mark_as_unvisited(l->root);
-	osdlib_draw_rec(l, l->root);
+	osdlib_walk_rec(l, l->root, fn, arg);
+}
+void osdlib_draw_element(const struct osd_element *e,
+		__attribute__((unused)) void *arg)
+{
+	gl_bind_texture(e->t);
+	glBegin(GL_QUADS);
+	glColor4f(1, 1, 1, e->a);
+	tm_coord_tl(e->t, e->tex_x, e->tex_y,
+			e->tex_w, e->tex_h);
+	glVertex3d(e->rx, e->ry, e->rz);
+	tm_coord_bl(e->t, e->tex_x, e->tex_y,
+			e->tex_w, e->tex_h);
+	glVertex3d(e->rx, e->ry + e->rh, e->rz);
+	tm_coord_br(e->t, e->tex_x, e->tex_y,
+			e->tex_w, e->tex_h);
+	glVertex3d(e->rx + e->rw, e->ry + e->rh, e->rz);
+	tm_coord_tr(e->t, e->tex_x, e->tex_y,
+			e->tex_w, e->tex_h);
+	glVertex3d(e->rx + e->rw, e->ry, e->rz);
+	glEnd();
+}
+void osdlib_draw(struct osd_layer *l)
+{
+	osdlib_walk(l, osdlib_draw_element, NULL);
 }
 
 void osdlib_free_rec(struct osd_element *e)
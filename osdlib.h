@@ -85,6 +85,9 @@ struct osd_layer {
 	struct osd_element *root;
 	struct animation *animation_list;
 };
+/* called for each visible element of a layer */
+typedef void (*osd_visit_fn)(const struct osd_element*, void*);
+
 struct coord c(enum side, enum side, double);
 struct coord margin(enum side, double);
 struct coord pad(enum side, double);
@@ -92,6 +95,7 @@ struct coord center();
 void osdlib_init(struct osd_layer*, double, double);
 void osdlib_step(struct osd_layer*, double);
 void osdlib_draw(struct osd_layer*);
+void osdlib_walk(struct osd_layer*, osd_visit_fn, void*);
 void osdlib_free(struct osd_layer*);
 void osdlib_make_children(struct osd_element*, size_t, int, ...);
 void o_init(struct osd_element*);
@@ -0,0 +1,84 @@
+/* pacer.c - frame scheduling of the viewer
+ * Copyright (C) 2026 FreeCG contributors.
+ *
+ * This file is part of FreeCG.
+ *
+ * FreeCG is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FreeCG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FreeCG. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* for nanosleep */
+#define _POSIX_C_SOURCE 199309L
+
+#include "pacer.h"
+#include "prof.h"
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+
+void pacer_init(struct pacer *p, double rate, int vsync)
+{
+	p->period = rate > 0 ? 1e9 / rate : 0;
+	p->vsync = vsync;
+	p->last = p->next = prof_now();
+	p->n = 0;
+	p->sum = p->sum2 = p->max = 0;
+}
+void pacer_sleep(uint64_t ns)
+{
+	struct timespec ts = {
+		.tv_sec = ns / 1000000000,
+		.tv_nsec = ns % 1000000000
+	};
+	while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+		;
+}
+/* waits until the next frame is due and returns the time in seconds since
+ * the previous one started */
+double pacer_wait(struct pacer *p)
+{
+	uint64_t now = prof_now();
+	if (p->period) {
+		uint64_t due = p->next;
+		if (p->vsync)
+			due -= due - p->last > PACER_VSYNC_SLACK_NS ?
+				PACER_VSYNC_SLACK_NS : 0;
+		uint64_t spin = p->vsync ? 0 : PACER_SPIN_NS;
+		if (now + spin < due)
+			pacer_sleep(due - spin - now);
+		while ((now = prof_now()) < due)
+			;
+		/* a frame late by more than a period restarts the schedule
+		 * instead of rushing the following ones */
+		p->next += p->period;
+		if (p->next < now)
+			p->next = now + p->period;
+	}
+	double dt = (now - p->last) / 1e9;
+	p->last = now;
+	p->n++;
+	p->sum += dt;
+	p->sum2 += dt * dt;
+	p->max = fmax(p->max, dt);
+	return dt;
+}
+/* statistics of the frame intervals since the previous report */
+void pacer_report(struct pacer *p, struct pacer_stats *st)
+{
+	st->n = p->n;
+	st->avg = p->n ? p->sum / p->n : 0;
+	st->jitter = p->n ? sqrt(fmax(0, p->sum2 / p->n - st->avg * st->avg)) : 0;
+	st->max = p->max;
+	p->n = 0;
+	p->sum = p->sum2 = p->max = 0;
+}
@@ -0,0 +1,57 @@
+/* pacer.h - frame scheduling of the viewer
+ * Copyright (C) 2026 FreeCG contributors.
+ *
+ * This file is part of FreeCG.
+ *
+ * FreeCG is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FreeCG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FreeCG. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PACER_H
+#define PACER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum pacer_consts {
+	/* sleeping is not precise, so this much of a wait is spun instead */
+	PACER_SPIN_NS = 1000000,
+	/* with vsync a frame is started this much early, the swap waits for
+	 * the retrace anyway */
+	PACER_VSYNC_SLACK_NS = 2000000
+};
+/* Schedules frames at a fixed rate on the monotonic clock, sleeping in
+ * between. A rate of 0 runs frames back to back, paced only by the swap if
+ * vsync is on. */
+struct pacer {
+	/* frame period in ns, 0 if unpaced */
+	uint64_t period;
+	int vsync;
+	/* when the next frame is due and when the last one started */
+	uint64_t next, last;
+	/* frame intervals since the last report, in seconds */
+	size_t n;
+	double sum, sum2, max;
+};
+struct pacer_stats {
+	size_t n;
+	/* mean frame interval, its standard deviation and the longest one, in
+	 * seconds */
+	double avg, jitter, max;
+};
+
+void pacer_init(struct pacer*, double, int);
+double pacer_wait(struct pacer*);
+void pacer_report(struct pacer*, struct pacer_stats*);
+
+#endif
@@ -0,0 +1,198 @@
+/* prof.c - low overhead timing of the phases of a simulation step and of a
+ * frame
+ * Copyright (C) 2026 FreeCG contributors.
+ *
+ * This file is part of FreeCG.
+ *
+ * FreeCG is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FreeCG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FreeCG. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* for clock_gettime */
+#define _POSIX_C_SOURCE 199309L
+
+#include "prof.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <math.h>
+
+static const char *phase_names[] = {
+	"objects_step", "ship_step", "collisions", "scene", "osd_step",
+	"osd_draw", "swap"
+};
+static struct prof_samples samples[PROF_NPHASES];
+int prof_on;
+
+void prof_enable(int on)
+{
+	prof_on = on;
+}
+uint64_t prof_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+void prof_add_to(struct prof_samples *s, uint64_t ns)
+{
+	s->ns[s->n++ & (PROF_WINDOW - 1)] = ns > UINT32_MAX ? UINT32_MAX : ns;
+}
+void prof_add(enum prof_phase ph, uint64_t ns)
+{
+	prof_add_to(&samples[ph], ns);
+}
+/* the samples reported by prof_print(), for the one instance whose phases
+ * are to be shown with the frame's */
+struct prof_samples *prof_phases(void)
+{
+	return samples;
+}
+
+int cmp_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t*)a,
+		 y = *(const uint32_t*)b;
+	return x < y ? -1 : x > y;
+}
+/* statistics of the samples in the window, in microseconds */
+void prof_get(enum prof_phase ph, struct prof_stats *st)
+{
+	const struct prof_samples *s = &samples[ph];
+	uint32_t sorted[PROF_WINDOW];
+	size_t n = s->n < PROF_WINDOW ? s->n : PROF_WINDOW;
+	memset(st, 0, sizeof(*st));
+	st->n = n;
+	if (n == 0)
+		return;
+	memcpy(sorted, s->ns, n * sizeof(*sorted));
+	qsort(sorted, n, sizeof(*sorted), cmp_u32);
+	double sum = 0;
+	for (size_t i = 0; i < n; ++i)
+		sum += sorted[i];
+	st->min = sorted[0] / 1000.0;
+	st->avg = sum / n / 1000.0;
+	st->p99 = sorted[(n - 1) * 99 / 100] / 1000.0;
+}
+void prof_print(FILE *fp)
+{
+	fprintf(fp, "%-13s %9s %9s %9s (us)\n", "phase", "min", "avg", "p99");
+	for (int ph = 0; ph < PROF_NPHASES; ++ph) {
+		struct prof_stats st;
+		prof_get(ph, &st);
+		if (st.n)
+			fprintf(fp, "%-13s %9.2f %9.2f %9.2f\n",
+					phase_names[ph], st.min, st.avg, st.p99);
+	}
+}
+/* appends the current statistics to a CSV file, one line per phase */
+int prof_export(const char *path, double time)
+{
+	FILE *fp = fopen(path, "a");
+	if (!fp) {
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	if (ftell(fp) == 0)
+		fprintf(fp, "time,phase,samples,min_us,avg_us,p99_us\n");
+	for (int ph = 0; ph < PROF_NPHASES; ++ph) {
+		struct prof_stats st;
+		prof_get(ph, &st);
+		fprintf(fp, "%.3f,%s,%zu,%.2f,%.2f,%.2f\n", time,
+				phase_names[ph], st.n, st.min, st.avg, st.p99);
+	}
+	fclose(fp);
+	return 0;
+}
+
+/* ==================== Frame histograms ==================== */
+/* Unlike the phases, the parts of every frame are kept for the whole run in
+ * histograms, and optionally dumped one line per frame. */
+static const char *part_names[] = {"cpu", "gpu", "swap"};
+static struct prof_hist frame_hist[PROF_NPARTS];
+static FILE *frame_fp;
+
+void prof_hist_add(struct prof_hist *h, uint64_t ns)
+{
+	uint64_t b = ns / PROF_HIST_STEP;
+	h->count[b < PROF_HIST_BUCKETS ? b : PROF_HIST_BUCKETS - 1]++;
+	h->n++;
+	if (ns > h->max)
+		h->max = ns;
+}
+/* the p-th quantile (0 < p <= 1) in microseconds, as the upper edge of its
+ * bucket */
+double prof_hist_percentile(const struct prof_hist *h, double p)
+{
+	uint64_t rank = ceil(p * h->n), sum = 0;
+	if (h->n == 0)
+		return 0;
+	for (size_t b = 0; b < PROF_HIST_BUCKETS - 1; ++b) {
+		sum += h->count[b];
+		if (sum >= rank)
+			return fmin((b + 1) * (PROF_HIST_STEP / 1000.0),
+					h->max / 1000.0);
+	}
+	return h->max / 1000.0;
+}
+void prof_frame(uint64_t frame, const uint64_t ns[PROF_NPARTS])
+{
+	for (int p = 0; p < PROF_NPARTS; ++p)
+		if (ns[p] != PROF_NONE)
+			prof_hist_add(&frame_hist[p], ns[p]);
+	if (!frame_fp)
+		return;
+	fprintf(frame_fp, "%llu", (unsigned long long)frame);
+	for (int p = 0; p < PROF_NPARTS; ++p)
+		if (ns[p] != PROF_NONE)
+			fprintf(frame_fp, ",%.1f", ns[p] / 1000.0);
+		else
+			fprintf(frame_fp, ",");
+	fprintf(frame_fp, "\n");
+}
+/* starts writing the parts of every frame to a CSV file */
+int prof_frame_dump(const char *path)
+{
+	frame_fp = fopen(path, "w");
+	if (!frame_fp) {
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	fprintf(frame_fp, "frame");
+	for (int p = 0; p < PROF_NPARTS; ++p)
+		fprintf(frame_fp, ",%s_us", part_names[p]);
+	fprintf(frame_fp, "\n");
+	return 0;
+}
+void prof_frame_print(FILE *fp)
+{
+	fprintf(fp, "%-13s %9s %9s %9s %9s (ms)\n", "frame part", "p50", "p95",
+			"p99", "max");
+	for (int p = 0; p < PROF_NPARTS; ++p) {
+		const struct prof_hist *h = &frame_hist[p];
+		if (h->n)
+			fprintf(fp, "%-13s %9.2f %9.2f %9.2f %9.2f\n",
+					part_names[p],
+					prof_hist_percentile(h, 0.50) / 1000,
+					prof_hist_percentile(h, 0.95) / 1000,
+					prof_hist_percentile(h, 0.99) / 1000,
+					h->max / 1e6);
+	}
+}
+void prof_frame_close(void)
+{
+	if (frame_fp)
+		fclose(frame_fp);
+	frame_fp = NULL;
+}
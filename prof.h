@@ -0,0 +1,115 @@
+/* prof.h - low overhead timing of the phases of a simulation step and of a
+ * frame
+ * Copyright (C) 2026 FreeCG contributors.
+ *
+ * This file is part of FreeCG.
+ *
+ * FreeCG is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FreeCG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FreeCG. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PROF_H
+#define PROF_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+enum prof_phase {
+	ProfObjectsStep = 0,
+	ProfShipStep,
+	ProfCollisions,
+	ProfScene,
+	ProfOsdStep,
+	ProfOsdDraw,
+	ProfSwap,
+	PROF_NPHASES
+};
+/* the parts of a frame recorded for the whole run */
+enum prof_frame_part {
+	/* from the end of the wait for the frame to the swap */
+	FrameCpu = 0,
+	/* drawing on the GPU, if the driver can measure it */
+	FrameGpu,
+	/* the swap, including waiting for the retrace */
+	FrameSwap,
+	PROF_NPARTS
+};
+enum prof_consts {
+	/* statistics are computed over this many latest samples of a phase,
+	 * must be a power of 2 */
+	PROF_WINDOW = 512,
+	/* frame histograms have buckets of PROF_HIST_STEP ns, the last one
+	 * holds everything longer */
+	PROF_HIST_BUCKETS = 2048,
+	PROF_HIST_STEP = 50000
+};
+struct prof_samples {
+	/* durations in ns, a ring buffer */
+	uint32_t ns[PROF_WINDOW];
+	/* the number of samples ever added */
+	uint64_t n;
+};
+struct prof_stats {
+	double min, avg, p99;
+	size_t n;
+};
+struct prof_hist {
+	uint32_t count[PROF_HIST_BUCKETS];
+	uint64_t n;
+	/* the longest sample, in ns */
+	uint64_t max;
+};
+/* stands for a part of a frame which was not measured */
+#define PROF_NONE UINT64_MAX
+
+/* Timing is off until prof_enable() is called. It is meant for the thread
+ * running the game; the simulation only times itself into the samples of
+ * its instance, see PROF_BEGIN_AT. Define NPROFILE to compile it out
+ * completely. */
+#ifndef NPROFILE
+extern int prof_on;
+#define PROF_BEGIN(ph) uint64_t prof_t_##ph = prof_on ? prof_now() : 0
+#define PROF_END(ph) do {                                         \
+	if (prof_on)                                              \
+		prof_add((ph), prof_now() - prof_t_##ph);         \
+} while (0)
+/* The same for the phases of a simulated instance, into its own samples
+ * p (an array of PROF_NPHASES), which are not touched if p is NULL */
+#define PROF_BEGIN_AT(p, ph) uint64_t prof_t_##ph = (p) ? prof_now() : 0
+#define PROF_END_AT(p, ph) do {                                   \
+	if (p)                                                    \
+		prof_add_to(&(p)[ph], prof_now() - prof_t_##ph);  \
+} while (0)
+#else
+#define PROF_BEGIN(ph) do {} while (0)
+#define PROF_END(ph) do {} while (0)
+#define PROF_BEGIN_AT(p, ph) do {} while (0)
+#define PROF_END_AT(p, ph) do {} while (0)
+#endif
+
+void prof_enable(int);
+uint64_t prof_now(void);
+void prof_add(enum prof_phase, uint64_t);
+void prof_add_to(struct prof_samples*, uint64_t);
+struct prof_samples *prof_phases(void);
+void prof_get(enum prof_phase, struct prof_stats*);
+void prof_print(FILE*);
+int prof_export(const char*, double);
+void prof_hist_add(struct prof_hist*, uint64_t);
+double prof_hist_percentile(const struct prof_hist*, double);
+void prof_frame(uint64_t, const uint64_t[PROF_NPARTS]);
+int prof_frame_dump(const char*);
+void prof_frame_print(FILE*);
+void prof_frame_close(void);
+
+#endif
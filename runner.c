@@ -0,0 +1,104 @@
+/* runner.c - a thread pool used to step many independent level instances
+ * concurrently
+ * Copyright (C) 2026 FreeCG contributors.
+ *
+ * This file is part of FreeCG.
+ *
+ * FreeCG is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FreeCG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FreeCG. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "runner.h"
+#include <stdlib.h>
+#include <assert.h>
+#include <unistd.h>
+
+size_t runner_ncpus(void)
+{
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? (size_t)n : 1;
+}
+
+/* Workers sleep until a new run (generation) is published, then take job
+ * indices one by one until there are none left */
+int runner_worker(void *data)
+{
+	struct runner *r = data;
+	unsigned int seen = 0;
+	SDL_mutexP(r->lock);
+	for (;;) {
+		while (r->generation == seen && !r->quit)
+			SDL_CondWait(r->work, r->lock);
+		if (r->quit)
+			break;
+		seen = r->generation;
+		while (r->next_job < r->njobs) {
+			size_t i = r->next_job++;
+			SDL_mutexV(r->lock);
+			r->job(r->arg, i);
+			SDL_mutexP(r->lock);
+			if (++r->ndone == r->njobs)
+				SDL_CondSignal(r->done);
+		}
+	}
+	SDL_mutexV(r->lock);
+	return 0;
+}
+
+struct runner *runner_new(size_t nthreads)
+{
+	struct runner *r = calloc(1, sizeof(*r));
+	assert(nthreads > 0);
+	r->nthreads = nthreads;
+	r->lock = SDL_CreateMutex();
+	r->work = SDL_CreateCond();
+	r->done = SDL_CreateCond();
+	r->threads = calloc(nthreads, sizeof(*r->threads));
+	for (size_t i = 0; i < nthreads; ++i)
+		r->threads[i] = SDL_CreateThread(runner_worker, r);
+	return r;
+}
+
+/* Calls job(arg, i) for every i in [0, njobs) using all threads of the pool
+ * and returns when all of them are finished */
+void runner_run(struct runner *r, size_t njobs, runner_job job, void *arg)
+{
+	if (njobs == 0)
+		return;
+	SDL_mutexP(r->lock);
+	r->job = job;
+	r->arg = arg;
+	r->njobs = njobs;
+	r->next_job = 0;
+	r->ndone = 0;
+	++r->generation;
+	SDL_CondBroadcast(r->work);
+	while (r->ndone < r->njobs)
+		SDL_CondWait(r->done, r->lock);
+	SDL_mutexV(r->lock);
+}
+
+void runner_free(struct runner *r)
+{
+	SDL_mutexP(r->lock);
+	r->quit = 1;
+	SDL_CondBroadcast(r->work);
+	SDL_mutexV(r->lock);
+	for (size_t i = 0; i < r->nthreads; ++i)
+		SDL_WaitThread(r->threads[i], NULL);
+	SDL_DestroyCond(r->done);
+	SDL_DestroyCond(r->work);
+	SDL_DestroyMutex(r->lock);
+	free(r->threads);
+	free(r);
+}
@@ -0,0 +1,51 @@
+/* runner.h - a thread pool used to step many independent level instances
+ * concurrently
+ * Copyright (C) 2026 FreeCG contributors.
+ *
+ * This file is part of FreeCG.
+ *
+ * FreeCG is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FreeCG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FreeCG. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RUNNER_H
+#define RUNNER_H
+
+#include <SDL/SDL.h>
+#include <SDL/SDL_thread.h>
+#include <stddef.h>
+
+/* a job is called once for each index in [0, njobs) of a single run */
+typedef void (*runner_job)(void*, size_t);
+struct runner {
+	size_t nthreads;
+	SDL_Thread **threads;
+	SDL_mutex *lock;
+	SDL_cond *work,
+		 *done;
+	/* current run, protected by lock */
+	runner_job job;
+	void *arg;
+	size_t njobs;
+	size_t next_job;
+	size_t ndone;
+	unsigned int generation;
+	int quit;
+};
+
+size_t runner_ncpus(void);
+struct runner *runner_new(size_t);
+void runner_run(struct runner*, size_t, runner_job, void*);
+void runner_free(struct runner*);
+
+#endif
@@ -0,0 +1,376 @@
+/* swrender.c - drawing a level into memory, without a display
+ * Copyright (C) 2026 FreeCG contributors.
+ *
+ * This file is part of FreeCG.
+ *
+ * FreeCG is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FreeCG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FreeCG. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "swrender.h"
+#include "mathgeom.h"
+#include "gfx.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* A CPU rasterizer which draws what the OpenGL renderer does: tiles ordered
+ * by depth, the ship, bullets and debris, with nearest texel sampling and
+ * alpha blending. It only needs the tileset as an SDL surface, so it works
+ * without a display and in many threads at once. */
+
+/* the tileset converted to RGBA bytes, the format sw_render samples */
+SDL_Surface *sw_tileset(const SDL_Surface *gfx)
+{
+	SDL_Surface *ts = SDL_CreateRGBSurface(0, gfx->w, gfx->h, 32,
+			RMASK, GMASK, BMASK, AMASK);
+	if (!ts)
+		return NULL;
+	SDL_BlitSurface((SDL_Surface*)gfx, NULL, ts, NULL);
+	return ts;
+}
+void sw_image_init(struct sw_image *im, int w, int h)
+{
+	im->w = w;
+	im->h = h;
+	im->px = malloc(4 * (size_t)w * h);
+	sw_clip(im, NULL);
+}
+void sw_image_free(struct sw_image *im)
+{
+	free(im->px);
+	im->px = NULL;
+}
+/* limits drawing to a rectangle of the image, NULL for the whole image */
+void sw_clip(struct sw_image *im, const SDL_Rect *r)
+{
+	if (!r) {
+		im->cx1 = im->cy1 = 0;
+		im->cx2 = im->w;
+		im->cy2 = im->h;
+		return;
+	}
+	im->cx1 = max(0, r->x);
+	im->cy1 = max(0, r->y);
+	im->cx2 = min(im->w, r->x + r->w);
+	im->cy2 = min(im->h, r->y + r->h);
+}
+
+static inline void sw_blend(uint8_t *d, const uint8_t *s)
+{
+	unsigned int a = s[3];
+	if (a == 255) {
+		d[0] = s[0], d[1] = s[1], d[2] = s[2];
+	} else if (a) {
+		for (int c = 0; c < 3; ++c)
+			d[c] = (s[c] * a + d[c] * (255 - a) + 127) / 255;
+	}
+}
+/* Blends a row of n pixels onto another, leaving the alpha of the destination
+ * as it is. With SSE2 four pixels are blended at once; runs of fully opaque
+ * or fully transparent texels, which make up most of the tileset, skip the
+ * arithmetic. x/255 is rounded as (x + 128 + (x + 128 >> 8)) >> 8, which
+ * gives the same results as sw_blend. */
+void sw_blend_row(uint8_t *d, const uint8_t *s, int n)
+{
+	int i = 0;
+#ifdef __SSE2__
+	const __m128i zero = _mm_setzero_si128(),
+	      amask = _mm_set1_epi32(0xff000000),
+	      c255 = _mm_set1_epi16(255),
+	      c128 = _mm_set1_epi16(128);
+	for (; i + 4 <= n; i += 4) {
+		__m128i sv = _mm_loadu_si128((const __m128i*)(s + 4*i)),
+			av = _mm_and_si128(sv, amask);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(av, zero)) == 0xffff)
+			continue;
+		__m128i dv = _mm_loadu_si128((const __m128i*)(d + 4*i)),
+			r;
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(av, amask)) == 0xffff) {
+			r = sv;
+		} else {
+			__m128i s16 = _mm_unpacklo_epi8(sv, zero),
+				d16 = _mm_unpacklo_epi8(dv, zero),
+				a16 = _mm_shufflehi_epi16(_mm_shufflelo_epi16(
+						s16, 0xff), 0xff),
+				t = _mm_add_epi16(_mm_add_epi16(
+					_mm_mullo_epi16(s16, a16),
+					_mm_mullo_epi16(d16,
+						_mm_sub_epi16(c255, a16))),
+					c128),
+				lo = _mm_srli_epi16(_mm_add_epi16(t,
+						_mm_srli_epi16(t, 8)), 8);
+			s16 = _mm_unpackhi_epi8(sv, zero);
+			d16 = _mm_unpackhi_epi8(dv, zero);
+			a16 = _mm_shufflehi_epi16(_mm_shufflelo_epi16(
+					s16, 0xff), 0xff);
+			t = _mm_add_epi16(_mm_add_epi16(
+				_mm_mullo_epi16(s16, a16),
+				_mm_mullo_epi16(d16, _mm_sub_epi16(c255, a16))),
+				c128);
+			__m128i hi = _mm_srli_epi16(_mm_add_epi16(t,
+					_mm_srli_epi16(t, 8)), 8);
+			r = _mm_packus_epi16(lo, hi);
+		}
+		r = _mm_or_si128(_mm_andnot_si128(amask, r),
+				_mm_and_si128(amask, dv));
+		_mm_storeu_si128((__m128i*)(d + 4*i), r);
+	}
+#endif
+	for (; i < n; ++i)
+		sw_blend(d + 4*i, s + 4*i);
+}
+/* the image pixels whose centers lie in [a, b) of the level, along one axis,
+ * within [lo, hi) */
+static inline void sw_span(double a, double b, double origin, double scale,
+		int lo, int hi, int *p1, int *p2)
+{
+	*p1 = fmax(lo, ceil((a - origin) * scale - 0.5));
+	*p2 = fmin(hi, ceil((b - origin) * scale - 0.5));
+}
+/* Draws the tex_w x tex_h texels at (tex_x, tex_y) of src stretched over the
+ * rectangle (x, y, w, h) of the image, with the opacity multiplied by
+ * alpha/255. Texels are sampled at pixel centers. Rows which map one to one
+ * onto texels are blended straight from the source, others are gathered
+ * first. */
+void sw_blit(struct sw_image *im, const SDL_Surface *src, double x, double y,
+		double w, double h, int tex_x, int tex_y, int tex_w, int tex_h,
+		unsigned int alpha)
+{
+	uint32_t row[SW_ROW];
+	int x1, x2, y1, y2;
+	if (!alpha || w <= 0 || h <= 0)
+		return;
+	sw_span(x, x + w, 0, 1, im->cx1, im->cx2, &x1, &x2);
+	sw_span(y, y + h, 0, 1, im->cy1, im->cy2, &y1, &y2);
+	double sx = tex_w / w,
+	       sy = tex_h / h;
+	int direct = alpha == 255 && w == tex_w && x == floor(x);
+	for (int py = y1; py < y2; ++py) {
+		int ty = (py + 0.5 - y) * sy;
+		ty = tex_y + (ty < 0 ? 0 : ty >= tex_h ? tex_h - 1 : ty);
+		const uint8_t *line = (const uint8_t*)src->pixels +
+			ty * src->pitch;
+		uint8_t *dst = im->px + 4 * ((size_t)py * im->w);
+		if (direct) {
+			sw_blend_row(dst + 4*x1,
+					line + 4 * (tex_x + x1 - (int)x),
+					x2 - x1);
+			continue;
+		}
+		for (int px = x1; px < x2; px += SW_ROW) {
+			int n = min(SW_ROW, x2 - px);
+			for (int k = 0; k < n; ++k) {
+				int tx = (px + k + 0.5 - x) * sx;
+				tx = tex_x + (tx < 0 ? 0 :
+						tx >= tex_w ? tex_w - 1 : tx);
+				memcpy(&row[k], line + 4 * tx, 4);
+				if (alpha != 255) {
+					uint8_t *c = (uint8_t*)&row[k];
+					c[3] = (c[3] * alpha + 127) / 255;
+				}
+			}
+			sw_blend_row(dst + 4*px, (const uint8_t*)row, n);
+		}
+	}
+}
+/* draws the w x h texels at (tex_x, tex_y) of the tileset at (x, y) */
+void sw_sprite(struct sw_image *im, const struct sw_view *v,
+		const SDL_Surface *ts, double x, double y, int w, int h,
+		int tex_x, int tex_y)
+{
+	sw_blit(im, ts, (x - v->x) * v->scale, (y - v->y) * v->scale,
+			w * v->scale, h * v->scale, tex_x, tex_y, w, h, 255);
+}
+/* fills a w x h rectangle at (x, y) of the level with a colour */
+void sw_fill(struct sw_image *im, const struct sw_view *v, double x,
+		double y, double w, double h, const uint8_t rgba[4])
+{
+	int x1, x2, y1, y2;
+	sw_span(x, x + w, v->x, v->scale, im->cx1, im->cx2, &x1, &x2);
+	sw_span(y, y + h, v->y, v->scale, im->cy1, im->cy2, &y1, &y2);
+	for (int py = y1; py < y2; ++py) {
+		uint8_t *dst = im->px + 4 * ((size_t)py * im->w + x1);
+		for (int px = x1; px < x2; ++px, dst += 4)
+			sw_blend(dst, rgba);
+	}
+}
+
+struct sw_item {
+	const struct tile *tile;
+	size_t order;
+};
+int sw_cmp_items(const void *a, const void *b)
+{
+	const struct sw_item *x = a, *y = b;
+	if (x->tile->z != y->tile->z)
+		return x->tile->z < y->tile->z ? -1 : 1;
+	return x->order < y->order ? -1 : x->order > y->order;
+}
+/* the first ntiles tiles of the blocks in the clipping rectangle, each once,
+ * from the lowest */
+size_t sw_collect(const struct cgl *l, const struct sw_view *v,
+		const struct sw_image *im, size_t ntiles,
+		struct sw_item **items)
+{
+	double x1 = fmax(0, v->x + im->cx1 / v->scale),
+	       y1 = fmax(0, v->y + im->cy1 / v->scale),
+	       x2 = fmin(l->width * BLOCK_SIZE, v->x + im->cx2 / v->scale),
+	       y2 = fmin(l->height * BLOCK_SIZE, v->y + im->cy2 / v->scale);
+	uint8_t *seen = calloc(l->ntiles, 1);
+	size_t n = 0, size = 64;
+	*items = malloc(size * sizeof(**items));
+	for (size_t j = y1 / BLOCK_SIZE; j * BLOCK_SIZE < y2; ++j)
+		for (size_t i = x1 / BLOCK_SIZE; i * BLOCK_SIZE < x2; ++i)
+			for (struct tile **t = l->blocks[j][i]; *t; ++t) {
+				size_t id = *t - l->tiles;
+				if (id >= ntiles || seen[id])
+					continue;
+				seen[id] = 1;
+				if (n == size) {
+					size *= 2;
+					*items = realloc(*items,
+						size * sizeof(**items));
+				}
+				(*items)[n].tile = *t;
+				(*items)[n].order = n;
+				++n;
+			}
+	free(seen);
+	qsort(*items, n, sizeof(**items), sw_cmp_items);
+	return n;
+}
+/* clears the clipping rectangle and draws the first ntiles tiles over it */
+void sw_draw_tiles(const struct cgl *l, const SDL_Surface *ts,
+		const struct sw_view *v, struct sw_image *im, size_t ntiles)
+{
+	/* the clear colour of the OpenGL renderer */
+	for (int y = im->cy1; y < im->cy2; ++y)
+		for (int x = im->cx1; x < im->cx2; ++x) {
+			uint8_t *p = im->px + 4 * ((size_t)y * im->w + x);
+			p[0] = p[1] = p[2] = 26, p[3] = 255;
+		}
+	struct sw_item *items;
+	size_t n = sw_collect(l, v, im, ntiles, &items);
+	for (size_t k = 0; k < n; ++k) {
+		const struct tile *t = items[k].tile;
+		if (tile_shown(t, l->time))
+			sw_sprite(im, v, ts, t->x, t->y, t->w, t->h,
+					anim_tex_x(t, l->time), t->tex_y);
+	}
+	free(items);
+}
+/* only the tiles which never change, without the ship */
+void sw_render_static(const struct cgl *l, const SDL_Surface *ts,
+		const struct sw_view *v, struct sw_image *im)
+{
+	sw_draw_tiles(l, ts, v, im, l->nstatic);
+}
+void sw_render(const struct cgl *l, const SDL_Surface *ts,
+		const struct sw_view *v, struct sw_image *im)
+{
+	sw_draw_tiles(l, ts, v, im, l->ntiles);
+	if (!l->ship->dead) {
+		struct tile ship;
+		ship_to_tile(l->ship, &ship);
+		sw_sprite(im, v, ts, l->ship->x, l->ship->y, ship.w, ship.h,
+				ship.tex_x, ship.tex_y);
+	}
+	static const uint8_t bullet[4] = {255, 230, 128, 255};
+	for (size_t i = 0; i < l->bullets.n; ++i)
+		sw_fill(im, v, l->bullets.x[i], l->bullets.y[i],
+				BULLET_SIDE, BULLET_SIDE, bullet);
+	for (size_t i = 0; i < l->kaboom.n; ++i) {
+		double t = l->kaboom.ttl[i] / KABOOM_TIME;
+		if (t <= 0)
+			continue;
+		uint8_t c[4] = {255, 255 * (0.3 + 0.7*t), 255 * 0.2*t, 255 * t};
+		sw_fill(im, v, l->kaboom.x[i], l->kaboom.y[i], 2, 2, c);
+	}
+}
+
+/* Draws the static tiles of the whole level reduced k times, every square of
+ * k x k level pixels averaged into one pixel of the image. The level is
+ * rendered at full size a strip at a time. Pixels of the image outside the
+ * reduced level are left as they are. */
+void sw_render_reduced(const struct cgl *l, const SDL_Surface *ts, int k,
+		struct sw_image *im)
+{
+	int lw = l->width * BLOCK_SIZE,
+	    lh = l->height * BLOCK_SIZE,
+	    w = min(im->w, (lw + k - 1) / k),
+	    h = min(im->h, (lh + k - 1) / k);
+	struct sw_image strip;
+	sw_image_init(&strip, lw, k * SW_STRIP);
+	uint32_t (*sum)[3] = malloc(w * sizeof(*sum));
+	for (int y0 = 0; y0 < h; y0 += SW_STRIP) {
+		struct sw_view v = {
+			.x = 0,
+			.y = y0 * k,
+			.scale = 1
+		};
+		sw_render_static(l, ts, &v, &strip);
+		for (int y = y0; y < min(h, y0 + SW_STRIP); ++y) {
+			/* the last row and column may be cut by the level */
+			int rows = min(k, lh - y * k);
+			memset(sum, 0, w * sizeof(*sum));
+			for (int r = 0; r < rows; ++r) {
+				const uint8_t *p = strip.px + 4 *
+					(size_t)((y - y0) * k + r) * lw;
+				for (int x = 0; x < w * k && x < lw; ++x, p += 4)
+					for (int c = 0; c < 3; ++c)
+						sum[x / k][c] += p[c];
+			}
+			uint8_t *dst = im->px + 4 * (size_t)y * im->w;
+			for (int x = 0; x < w; ++x, dst += 4) {
+				int n = rows * min(k, lw - x * k);
+				for (int c = 0; c < 3; ++c)
+					dst[c] = (sum[x][c] + n / 2) / n;
+				dst[3] = 255;
+			}
+		}
+	}
+	free(sum);
+	sw_image_free(&strip);
+}
+/* halves the image in place, averaging squares of 2 x 2 pixels (or pairs once
+ * a side is down to 1) */
+void sw_image_halve(struct sw_image *im)
+{
+	int sx = im->w > 1 ? 2 : 1,
+	    sy = im->h > 1 ? 2 : 1,
+	    w = im->w / sx,
+	    h = im->h / sy;
+	/* a pixel is only overwritten after it has been read */
+	for (int y = 0; y < h; ++y)
+		for (int x = 0; x < w; ++x) {
+			unsigned int s[4] = {0};
+			for (int j = 0; j < sy; ++j)
+				for (int i = 0; i < sx; ++i) {
+					const uint8_t *p = im->px + 4 *
+						((size_t)(sy*y + j) * im->w +
+						 sx*x + i);
+					for (int c = 0; c < 4; ++c)
+						s[c] += p[c];
+				}
+			uint8_t *d = im->px + 4 * ((size_t)y * w + x);
+			for (int c = 0; c < 4; ++c)
+				d[c] = (s[c] + sx*sy/2) / (sx*sy);
+		}
+	im->w = w;
+	im->h = h;
+	sw_clip(im, NULL);
+}
@@ -0,0 +1,62 @@
+/* swrender.h - drawing a level into memory, without a display
+ * Copyright (C) 2026 FreeCG contributors.
+ *
+ * This file is part of FreeCG.
+ *
+ * FreeCG is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FreeCG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FreeCG. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SWRENDER_H
+#define SWRENDER_H
+
+#include "cg.h"
+#include <SDL/SDL.h>
+#include <stdint.h>
+
+enum swrender_consts {
+	/* pixels gathered at once by a scaled blit */
+	SW_ROW = 256,
+	/* rows of a reduced image rendered at once */
+	SW_STRIP = 8
+};
+/* an RGBA image, rows from the top */
+struct sw_image {
+	int w, h;
+	uint8_t *px;
+	/* only the pixels in [cx1, cx2) x [cy1, cy2) are drawn to */
+	int cx1, cy1, cx2, cy2;
+};
+/* the part of the level shown: (x, y) is the point of the level at the top
+ * left corner of the image and scale is in image pixels per level pixel */
+struct sw_view {
+	double x, y;
+	double scale;
+};
+
+SDL_Surface *sw_tileset(const SDL_Surface*);
+void sw_image_init(struct sw_image*, int, int);
+void sw_image_free(struct sw_image*);
+void sw_clip(struct sw_image*, const SDL_Rect*);
+void sw_blend_row(uint8_t*, const uint8_t*, int);
+void sw_blit(struct sw_image*, const SDL_Surface*, double, double, double,
+		double, int, int, int, int, unsigned int);
+void sw_render(const struct cgl*, const SDL_Surface*, const struct sw_view*,
+		struct sw_image*);
+void sw_render_static(const struct cgl*, const SDL_Surface*,
+		const struct sw_view*, struct sw_image*);
+void sw_render_reduced(const struct cgl*, const SDL_Surface*, int,
+		struct sw_image*);
+void sw_image_halve(struct sw_image*);
+
+#endif
@@ -0,0 +1,403 @@
+/* swview.c - software rendering of the level view
+ * Copyright (C) 2026 FreeCG contributors.
+ *
+ * This file is part of FreeCG.
+ *
+ * FreeCG is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FreeCG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FreeCG. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "swview.h"
+#include "graphics.h"
+#include "osd.h"
+#include "mathgeom.h"
+#include "gfx.h"
+#include "prof.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/* A renderer for machines without usable OpenGL. The level is drawn by
+ * swrender into a framebuffer which persists between frames, so only what
+ * changed is drawn again: when the camera moves the framebuffer is scrolled
+ * by whole pixels and the exposed strips are redrawn, then the rectangles
+ * damaged by the ship, bullets, debris, dynamic tiles which changed and the
+ * OSD are redrawn, each clipped to its own rectangle. */
+
+struct swengine sw;
+
+void sw_init(SDL_Surface *screen, struct cgl *l, SDL_Surface *atlas,
+		struct texmgr *ttm, struct texmgr *ftm, struct texmgr *otm,
+		struct texmgr *mtm)
+{
+	extern void gl_visible_init(struct gl_visible*, const struct cgl*);
+	gl.ttm = ttm;
+	gl.ftm = ftm;
+	gl.otm = otm;
+	gl.mtm = mtm;
+	gl.frame = 1;
+	gl.l = l;
+	gl.cam.scale = 1;
+	gl.cam.x = l->width  * BLOCK_SIZE / 2;
+	gl.cam.y = l->height * BLOCK_SIZE / 2;
+	gl.win_w = screen->w;
+	gl.win_h = screen->h;
+	gl_visible_init(&gl.vis, l);
+	gl.ft.begin = prof_now();
+	sw.screen = screen;
+	sw.atlas = atlas;
+	/* the tileset is sampled in place, through a surface starting at its
+	 * corner of the atlas */
+	sw.tileset = SDL_CreateRGBSurfaceFrom((uint8_t*)atlas->pixels +
+			ttm->y * atlas->pitch + 4 * ttm->x,
+			atlas->w - ttm->x, atlas->h - ttm->y, 32, atlas->pitch,
+			RMASK, GMASK, BMASK, AMASK);
+	sw_image_init(&sw.fb, screen->w, screen->h);
+	sw.fb_surface = SDL_CreateRGBSurfaceFrom(sw.fb.px, sw.fb.w, sw.fb.h,
+			32, 4 * sw.fb.w, RMASK, GMASK, BMASK, AMASK);
+	/* the framebuffer is opaque, it is copied rather than blended */
+	SDL_SetAlpha(sw.fb_surface, 0, SDL_ALPHA_OPAQUE);
+	size_t ndynamic = l->ntiles - l->nstatic;
+	sw.tiles = malloc(ndynamic * sizeof(*sw.tiles));
+	for (size_t i = 0; i < ndynamic; ++i)
+		sw.tiles[i].shown = -1;
+	sw.full = 1;
+	osd_init();
+	SDL_ShowCursor(SDL_DISABLE);
+}
+void sw_free(void)
+{
+	extern void gl_visible_free(struct gl_visible*);
+	gl_visible_free(&gl.vis);
+	SDL_FreeSurface(sw.fb_surface);
+	SDL_FreeSurface(sw.tileset);
+	SDL_FreeSurface(sw.atlas);
+	sw_image_free(&sw.fb);
+	free(sw.tiles);
+	free(sw.moving);
+	free(sw.osd);
+	free(sw.osd_prev);
+	memset(&sw, 0, sizeof(sw));
+}
+
+/* ==================== Damage ==================== */
+/* adds the rectangle (x1, y1), (x2, y2) of the window to be redrawn, merged
+ * with the ones it touches */
+void sw_damage(int x1, int y1, int x2, int y2)
+{
+	x1 = max(x1, 0);
+	y1 = max(y1, 0);
+	x2 = min(x2, sw.fb.w);
+	y2 = min(y2, sw.fb.h);
+	if (sw.full || x1 >= x2 || y1 >= y2)
+		return;
+	for (size_t i = 0; i < sw.ndirty; ) {
+		const SDL_Rect *d = &sw.dirty[i];
+		if (x1 <= d->x + d->w && d->x <= x2 &&
+				y1 <= d->y + d->h && d->y <= y2) {
+			x1 = min(x1, d->x);
+			y1 = min(y1, d->y);
+			x2 = max(x2, d->x + d->w);
+			y2 = max(y2, d->y + d->h);
+			sw.dirty[i] = sw.dirty[--sw.ndirty];
+			/* the union may touch the ones already passed */
+			i = 0;
+		} else {
+			++i;
+		}
+	}
+	if (sw.ndirty == SW_MAX_DIRTY) {
+		sw.full = 1;
+		return;
+	}
+	sw.dirty[sw.ndirty++] = (SDL_Rect){
+		.x = x1,
+		.y = y1,
+		.w = x2 - x1,
+		.h = y2 - y1
+	};
+}
+/* the same for a rectangle of the level */
+void sw_damage_level(const struct sw_view *v, double x, double y,
+		double w, double h)
+{
+	sw_damage(floor((x - v->x) * v->scale), floor((y - v->y) * v->scale),
+			ceil((x + w - v->x) * v->scale),
+			ceil((y + h - v->y) * v->scale));
+}
+void sw_add_moving(double x, double y, double w, double h)
+{
+	if (sw.nmoving == sw.moving_size) {
+		sw.moving_size = sw.moving_size ? 2 * sw.moving_size : 64;
+		sw.moving = realloc(sw.moving,
+				sw.moving_size * sizeof(*sw.moving));
+	}
+	sw.moving[sw.nmoving++] = (struct drect){
+		.x = x,
+		.y = y,
+		.w = w,
+		.h = h
+	};
+}
+/* the ship, bullets and debris are damaged where they were and where they are
+ * now; the debris as one rectangle around all of it */
+void sw_damage_moving(const struct sw_view *v)
+{
+	const struct cgl *l = gl.l;
+	for (size_t i = 0; i < sw.nmoving; ++i)
+		sw_damage_level(v, sw.moving[i].x, sw.moving[i].y,
+				sw.moving[i].w, sw.moving[i].h);
+	sw.nmoving = 0;
+	if (!l->ship->dead) {
+		struct tile ship;
+		ship_to_tile(l->ship, &ship);
+		sw_add_moving(l->ship->x, l->ship->y, ship.w, ship.h);
+	}
+	for (size_t i = 0; i < l->bullets.n; ++i)
+		sw_add_moving(l->bullets.x[i], l->bullets.y[i],
+				BULLET_SIDE, BULLET_SIDE);
+	double x1 = INFINITY, y1 = INFINITY,
+	       x2 = -INFINITY, y2 = -INFINITY;
+	for (size_t i = 0; i < l->kaboom.n; ++i) {
+		if (l->kaboom.ttl[i] <= 0)
+			continue;
+		x1 = fmin(x1, l->kaboom.x[i]);
+		y1 = fmin(y1, l->kaboom.y[i]);
+		x2 = fmax(x2, l->kaboom.x[i] + 2);
+		y2 = fmax(y2, l->kaboom.y[i] + 2);
+	}
+	if (x1 < x2)
+		sw_add_moving(x1, y1, x2 - x1, y2 - y1);
+	for (size_t i = 0; i < sw.nmoving; ++i)
+		sw_damage_level(v, sw.moving[i].x, sw.moving[i].y,
+				sw.moving[i].w, sw.moving[i].h);
+}
+static inline int sw_tile_changed(const struct sw_tile_state *a,
+		const struct sw_tile_state *b)
+{
+	return a->shown != b->shown || a->x != b->x || a->y != b->y ||
+		a->w != b->w || a->h != b->h ||
+		a->tex_x != b->tex_x || a->tex_y != b->tex_y;
+}
+/* Compares the dynamic tiles of the blocks intersecting (x1, y1), (x2, y2)
+ * with what was drawn of them and damages both the old and the new place of
+ * the ones which changed. The blocks are walked like gl_draw_dynamic does. */
+void sw_damage_tiles(const struct sw_view *v, double x1, double y1,
+		double x2, double y2)
+{
+	struct gl_visible *vis = &gl.vis;
+	const struct cgl *l = gl.l;
+	for (size_t j = y1/BLOCK_SIZE; j*BLOCK_SIZE < y2; ++j) {
+		if (!vis->row[j])
+			continue;
+		for (size_t i = x1/BLOCK_SIZE; i*BLOCK_SIZE < x2; ++i) {
+			if (!vis->col[i])
+				continue;
+			size_t b = j*l->width + i;
+			for (size_t k = vis->first[b]; k < vis->first[b + 1];
+					++k) {
+				uint32_t id = vis->ids[k];
+				if (vis->drawn[id] == gl.frame)
+					continue;
+				vis->drawn[id] = gl.frame;
+				const struct tile *t = &l->tiles[id];
+				struct sw_tile_state now = {
+					.x = t->x,
+					.y = t->y,
+					.w = t->w,
+					.h = t->h,
+					.tex_x = anim_tex_x(t, l->time),
+					.tex_y = t->tex_y,
+					.shown = tile_shown(t, l->time)
+				};
+				struct sw_tile_state *old =
+					&sw.tiles[id - l->nstatic];
+				if (!sw_tile_changed(old, &now))
+					continue;
+				if (old->shown == 1)
+					sw_damage_level(v, old->x, old->y,
+							old->w, old->h);
+				if (now.shown)
+					sw_damage_level(v, t->x, t->y,
+							t->w, t->h);
+				*old = now;
+			}
+		}
+	}
+}
+void sw_collect_osd(const struct osd_element *e,
+		__attribute__((unused)) void *arg)
+{
+	if (sw.nosd == sw.osd_size) {
+		sw.osd_size = sw.osd_size ? 2 * sw.osd_size : 64;
+		sw.osd = realloc(sw.osd, sw.osd_size * sizeof(*sw.osd));
+	}
+	sw.osd[sw.nosd++] = (struct sw_osd_item){
+		.r = {
+			.x = e->rx,
+			.y = e->ry,
+			.w = e->rw,
+			.h = e->rh
+		},
+		.e = e
+	};
+}
+/* The OSD is redrawn where it is and where it was, both before and after the
+ * framebuffer was scrolled by (dx, dy), since the old OSD moved with it. */
+void sw_damage_osd(int dx, int dy)
+{
+	for (size_t i = 0; i < sw.nosd_prev; ++i) {
+		const SDL_Rect *r = &sw.osd_prev[i];
+		sw_damage(r->x, r->y, r->x + r->w, r->y + r->h);
+		if (dx || dy)
+			sw_damage(r->x - dx, r->y - dy,
+					r->x - dx + r->w, r->y - dy + r->h);
+	}
+	sw.nosd = 0;
+	osd_walk(sw_collect_osd, NULL);
+	if (sw.osd_prev_size < sw.nosd) {
+		sw.osd_prev_size = sw.osd_size;
+		sw.osd_prev = realloc(sw.osd_prev,
+				sw.osd_prev_size * sizeof(*sw.osd_prev));
+	}
+	sw.nosd_prev = sw.nosd;
+	for (size_t i = 0; i < sw.nosd; ++i) {
+		const struct drect *d = &sw.osd[i].r;
+		SDL_Rect *r = &sw.osd_prev[i];
+		r->x = floor(d->x);
+		r->y = floor(d->y);
+		r->w = ceil(d->x + d->w) - r->x;
+		r->h = ceil(d->y + d->h) - r->y;
+		sw_damage(r->x, r->y, r->x + r->w, r->y + r->h);
+	}
+}
+/* ==================== /Damage ==================== */
+
+/* moves the contents of the framebuffer by the whole pixels the view moved,
+ * the exposed strips are left to be redrawn */
+void sw_scroll(int dx, int dy)
+{
+	struct sw_image *fb = &sw.fb;
+	int w = fb->w - abs(dx),
+	    h = fb->h - abs(dy);
+	size_t pitch = 4 * (size_t)fb->w;
+	uint8_t *to = fb->px + 4 * max(0, -dx),
+		*from = fb->px + 4 * max(0, dx);
+	if (dy >= 0) {
+		for (int y = 0; y < h; ++y)
+			memmove(to + y * pitch, from + (y + dy) * pitch, 4 * w);
+	} else {
+		for (int y = h - 1; y >= 0; --y)
+			memmove(to + (y - dy) * pitch, from + y * pitch, 4 * w);
+	}
+	if (dx > 0)
+		sw_damage(fb->w - dx, 0, fb->w, fb->h);
+	else if (dx < 0)
+		sw_damage(0, 0, -dx, fb->h);
+	if (dy > 0)
+		sw_damage(0, fb->h - dy, fb->w, fb->h);
+	else if (dy < 0)
+		sw_damage(0, 0, fb->w, -dy);
+}
+void sw_draw_osd(const SDL_Rect *clip)
+{
+	for (size_t i = 0; i < sw.nosd; ++i) {
+		const struct drect *r = &sw.osd[i].r;
+		const struct osd_element *e = sw.osd[i].e;
+		if (r->x >= clip->x + clip->w || r->x + r->w <= clip->x ||
+				r->y >= clip->y + clip->h ||
+				r->y + r->h <= clip->y)
+			continue;
+		sw_blit(&sw.fb, sw.atlas, r->x, r->y, r->w, r->h,
+				e->t->x + e->tex_x, e->t->y + e->tex_y,
+				e->tex_w, e->tex_h, 255 * fmin(1, e->a));
+	}
+}
+void sw_update_window(double time)
+{
+	double dt = time - gl.time;
+	gl_cam_step(dt);
+	gl_set_viewport(gl.cam.x, gl.cam.y, gl.cam.scale);
+	/* the view is kept on whole pixels, so that the framebuffer can be
+	 * scrolled */
+	struct sw_view v = {
+		.x = round(gl.viewport.x * gl.cam.scale) / gl.cam.scale,
+		.y = round(gl.viewport.y * gl.cam.scale) / gl.cam.scale,
+		.scale = gl.cam.scale
+	};
+	int dx = 0, dy = 0;
+	sw.ndirty = 0;
+	if (v.scale != sw.view.scale) {
+		sw.full = 1;
+	} else if (!sw.full) {
+		dx = lround((v.x - sw.view.x) * v.scale);
+		dy = lround((v.y - sw.view.y) * v.scale);
+		if (abs(dx) >= sw.fb.w || abs(dy) >= sw.fb.h)
+			sw.full = 1;
+		else if (dx || dy)
+			sw_scroll(dx, dy);
+	}
+	PROF_BEGIN(ProfOsdStep);
+	osd_step(time);
+	PROF_END(ProfOsdStep);
+	PROF_BEGIN(ProfScene);
+	sw_damage_moving(&v);
+	sw_damage_tiles(&v, fmax(0, v.x), fmax(0, v.y),
+			fmin(v.x + sw.fb.w / v.scale,
+				gl.l->width * BLOCK_SIZE),
+			fmin(v.y + sw.fb.h / v.scale,
+				gl.l->height * BLOCK_SIZE));
+	sw_damage_osd(dx, dy);
+	SDL_Rect all = {
+		.x = 0,
+		.y = 0,
+		.w = sw.fb.w,
+		.h = sw.fb.h
+	};
+	SDL_Rect *rects = sw.full ? &all : sw.dirty;
+	size_t n = sw.full ? 1 : sw.ndirty;
+	for (size_t i = 0; i < n; ++i) {
+		sw_clip(&sw.fb, &rects[i]);
+		sw_render(gl.l, sw.tileset, &v, &sw.fb);
+	}
+	PROF_END(ProfScene);
+	PROF_BEGIN(ProfOsdDraw);
+	for (size_t i = 0; i < n; ++i) {
+		sw_clip(&sw.fb, &rects[i]);
+		sw_draw_osd(&rects[i]);
+	}
+	sw_clip(&sw.fb, NULL);
+	PROF_END(ProfOsdDraw);
+	uint64_t swap = prof_now();
+	PROF_BEGIN(ProfSwap);
+	/* after scrolling everything moved on the screen */
+	if (dx || dy) {
+		rects = &all;
+		n = 1;
+	}
+	for (size_t i = 0; i < n; ++i) {
+		SDL_Rect dst = rects[i];
+		SDL_BlitSurface(sw.fb_surface, &rects[i], sw.screen, &dst);
+	}
+	SDL_UpdateRects(sw.screen, n, rects);
+	PROF_END(ProfSwap);
+	uint64_t ns[PROF_NPARTS];
+	ns[FrameCpu] = swap - gl.ft.begin;
+	ns[FrameGpu] = PROF_NONE;
+	ns[FrameSwap] = prof_now() - swap;
+	prof_frame(gl.frame, ns);
+	++gl.frame;
+	sw.view = v;
+	sw.full = 0;
+	gl.time = time;
+}
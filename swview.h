@@ -0,0 +1,82 @@
+/* swview.h - software rendering of the level view
+ * Copyright (C) 2026 FreeCG contributors.
+ *
+ * This file is part of FreeCG.
+ *
+ * FreeCG is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FreeCG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FreeCG. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SWVIEW_H
+#define SWVIEW_H
+
+#include "cg.h"
+#include "swrender.h"
+#include "texmgr.h"
+#include "osdlib.h"
+#include <SDL/SDL.h>
+
+enum swview_consts {
+	/* largest atlas the software renderer packs the images into */
+	SW_ATLAS_SIZE = 8192,
+	/* with more damaged rectangles the whole window is redrawn */
+	SW_MAX_DIRTY = 64
+};
+/* the part of a dynamic tile which decides how it looks */
+struct sw_tile_state {
+	short x, y;
+	unsigned short w, h;
+	short tex_x, tex_y;
+	/* -1 if not drawn yet */
+	int shown;
+};
+/* a visible OSD element, in window pixels */
+struct sw_osd_item {
+	struct drect r;
+	const struct osd_element *e;
+};
+/* Renders into a framebuffer in memory and copies the changed parts of it to
+ * the window. The camera, the viewport, the visibility index and the OSD are
+ * shared with the OpenGL renderer through gl. */
+struct swengine {
+	SDL_Surface *screen;
+	/* the images of the texture managers and the tileset inside it */
+	SDL_Surface *atlas, *tileset;
+	struct sw_image fb;
+	SDL_Surface *fb_surface;
+	/* the view of the previous frame */
+	struct sw_view view;
+	/* redraw the whole window in the next frame */
+	int full;
+	SDL_Rect dirty[SW_MAX_DIRTY];
+	size_t ndirty;
+	/* what was drawn of the dynamic tiles, by tile id - nstatic */
+	struct sw_tile_state *tiles;
+	/* the ship, bullets and debris of the previous frame, in level
+	 * coordinates */
+	struct drect *moving;
+	size_t nmoving, moving_size;
+	/* the OSD of this and of the previous frame */
+	struct sw_osd_item *osd;
+	size_t nosd, osd_size;
+	SDL_Rect *osd_prev;
+	size_t nosd_prev, osd_prev_size;
+};
+extern struct swengine sw;
+
+void sw_init(SDL_Surface*, struct cgl*, SDL_Surface*, struct texmgr*,
+		struct texmgr*, struct texmgr*, struct texmgr*);
+void sw_free(void);
+void sw_update_window(double);
+
+#endif
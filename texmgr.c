@@ -20,6 +20,7 @@
 #include "texmgr.h"
 #include "gfx.h"
 #include <math.h>
+#include <stdlib.h>
 
 struct texmgr *tm_request_texture(const SDL_Surface *image)
 {
@@ -59,3 +60,111 @@ GLuint tm_load_texture(SDL_Surface *image)
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
 	return texno;
 }
+
+/* ==================== Atlas ==================== */
+/* Several images are packed into one texture, so that everything drawn with
+ * them needs a single bind and only the atlas is padded to a power of two.
+ * Images are put on shelves, tallest first. */
+/* the images being sorted by tm_cmp_height, as qsort has no user argument */
+static const SDL_Surface **atlas_images;
+int tm_cmp_height(const void *a, const void *b)
+{
+	int ha = atlas_images[*(const size_t*)a]->h,
+	    hb = atlas_images[*(const size_t*)b]->h;
+	return hb - ha;
+}
+/* places the images (in the given order) on shelves of width w, returns the
+ * height used */
+int tm_shelve(const SDL_Surface *images[], const size_t order[], size_t n,
+		int w, int xs[], int ys[])
+{
+	int x = 0, y = 0, shelf_h = 0;
+	for (size_t k = 0; k < n; ++k) {
+		const SDL_Surface *im = images[order[k]];
+		if (x > 0 && x + im->w > w) {
+			y += shelf_h + ATLAS_GUTTER;
+			x = shelf_h = 0;
+		}
+		xs[order[k]] = x, ys[order[k]] = y;
+		x += im->w + ATLAS_GUTTER;
+		if (im->h > shelf_h)
+			shelf_h = im->h;
+	}
+	return y + shelf_h;
+}
+/* Packs n images into a single surface of at most max_size on each side;
+ * tm[i] receives the place of image i. Returns the new surface, or NULL if
+ * they do not fit. Not reentrant: the order is sorted through the static
+ * atlas_images. */
+SDL_Surface *tm_pack_atlas(const SDL_Surface *images[], size_t n,
+		struct texmgr *tm[], int max_size)
+{
+	size_t *order = malloc(n * sizeof(*order));
+	int *xs = malloc(n * sizeof(*xs)),
+	    *ys = malloc(n * sizeof(*ys));
+	int widest = 1;
+	for (size_t i = 0; i < n; ++i) {
+		order[i] = i;
+		if (images[i]->w > widest)
+			widest = images[i]->w;
+	}
+	atlas_images = images;
+	qsort(order, n, sizeof(*order), tm_cmp_height);
+	/* try the power of two widths which fit the widest image and keep
+	 * the one with the smallest area */
+	int best_w = 0, best_h = 0;
+	for (int w = 1 << (int)ceil(log2(widest)); w <= max_size; w *= 2) {
+		int h = tm_shelve(images, order, n, w, xs, ys);
+		h = 1 << (int)ceil(log2(h > 0 ? h : 1));
+		if (h <= max_size &&
+				(!best_w || (long)w * h < (long)best_w * best_h)) {
+			best_w = w;
+			best_h = h;
+		}
+	}
+	if (!best_w) {
+		free(order);
+		free(xs);
+		free(ys);
+		return NULL;
+	}
+	tm_shelve(images, order, n, best_w, xs, ys);
+	SDL_Surface *atlas = SDL_CreateRGBSurface(0, best_w, best_h, 32,
+			RMASK, GMASK, BMASK, AMASK);
+	for (size_t i = 0; i < n; ++i) {
+		SDL_Rect dst = {
+			.x = xs[i],
+			.y = ys[i]
+		};
+		SDL_BlitSurface((SDL_Surface*)images[i], NULL, atlas, &dst);
+		tm[i] = calloc(1, sizeof(*tm[i]));
+		tm[i]->w = best_w;
+		tm[i]->h = best_h;
+		tm[i]->x = xs[i];
+		tm[i]->y = ys[i];
+	}
+	free(order);
+	free(xs);
+	free(ys);
+	return atlas;
+}
+
+int tm_request_atlas(const SDL_Surface *images[], size_t n,
+		struct texmgr *tm[])
+{
+	extern GLuint tm_load_texture(SDL_Surface*);
+	GLint max_size;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+	SDL_Surface *atlas = tm_pack_atlas(images, n, tm, max_size);
+	if (!atlas)
+		return -1;
+	if (SDL_MUSTLOCK(atlas))
+		SDL_LockSurface(atlas);
+	GLuint texno = tm_load_texture(atlas);
+	if (SDL_MUSTLOCK(atlas))
+		SDL_UnlockSurface(atlas);
+	SDL_FreeSurface(atlas);
+	for (size_t i = 0; i < n; ++i)
+		tm[i]->texno = texno;
+	return 0;
+}
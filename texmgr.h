@@ -23,33 +23,47 @@
 #include <SDL/SDL.h>
 #include <SDL/SDL_opengl.h>
 
+enum texmgr_consts {
+	/* transparent texels left between images of an atlas */
+	ATLAS_GUTTER = 1
+};
+/* An image in a texture: w and h are the dimensions of the whole texture,
+ * x and y the position of the image in it. Images packed into one atlas
+ * share texno. */
 struct texmgr {
 	double w, h;
+	int x, y;
 	GLuint texno;
 };
 
 static inline void tm_coord_tl(struct texmgr *tm, int x, int y,
 		__attribute__((unused)) int w, __attribute__((unused)) int h)
 {
-	glTexCoord2f((double)x / tm->w,
-			(double)y / tm->h);
+	glTexCoord2f((double)(tm->x + x) / tm->w,
+			(double)(tm->y + y) / tm->h);
 }
 static inline void tm_coord_bl(struct texmgr *tm, int x, int y, __attribute__((unused)) int w, int h)
 {
-	glTexCoord2f((double)x / tm->w,
-			(double)(y + h) / tm->h);
+	glTexCoord2f((double)(tm->x + x) / tm->w,
+			(double)(tm->y + y + h) / tm->h);
 }
 static inline void tm_coord_br(struct texmgr *tm, int x, int y, int w, int h)
 {
-	glTexCoord2f((double)(x + w) / tm->w,
-			(double)(y + h) / tm->h);
+	glTexCoord2f((double)(tm->x + x + w) / tm->w,
+			(double)(tm->y + y + h) / tm->h);
 }
 static inline void tm_coord_tr(struct texmgr *tm, int x, int y, int w, __attribute__((unused)) int h)
 {
-	glTexCoord2f((double)(x + w) / tm->w,
-			(double)y / tm->h);
+	glTexCoord2f((double)(tm->x + x + w) / tm->w,
+			(double)(tm->y + y) / tm->h);
 }
 
 struct texmgr *tm_request_texture(const SDL_Surface*);
+/* packs the images into one RGBA surface no larger than the given size, NULL
+ * if they do not fit; tm gets the positions, texno is left 0. Not
+ * reentrant. */
+SDL_Surface *tm_pack_atlas(const SDL_Surface *[], size_t, struct texmgr *[],
+		int);
+int tm_request_atlas(const SDL_Surface *[], size_t, struct texmgr *[]);
 
 #endif
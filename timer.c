@@ -0,0 +1,112 @@
+/* timer.c - a hashed timer wheel for the simulation's deadlines
+ * Copyright (C) 2026 FreeCG contributors.
+ *
+ * This file is part of FreeCG.
+ *
+ * FreeCG is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FreeCG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FreeCG. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "timer.h"
+#include <stdlib.h>
+#include <math.h>
+
+static inline int64_t timer_tick(double time)
+{
+	return (int64_t)floor(time * TIMER_RES);
+}
+
+void timer_wheel_init(struct timer_wheel *w, size_t ntimers)
+{
+	w->ntimers = ntimers;
+	w->timers = calloc(ntimers, sizeof(*w->timers));
+	w->due = calloc(ntimers, sizeof(*w->due));
+	for (size_t i = 0; i < ntimers; ++i)
+		w->timers[i].slot = -1;
+	for (size_t s = 0; s < TIMER_SLOTS; ++s)
+		w->head[s] = -1;
+	w->tick = 0;
+}
+void timer_wheel_free(struct timer_wheel *w)
+{
+	free(w->timers);
+	free(w->due);
+	w->timers = NULL;
+	w->due = NULL;
+}
+
+int timer_armed(const struct timer_wheel *w, size_t id)
+{
+	return w->timers[id].slot >= 0;
+}
+void timer_cancel(struct timer_wheel *w, size_t id)
+{
+	struct timer *t = &w->timers[id];
+	if (t->slot < 0)
+		return;
+	if (t->prev >= 0)
+		w->timers[t->prev].next = t->next;
+	else
+		w->head[t->slot] = t->next;
+	if (t->next >= 0)
+		w->timers[t->next].prev = t->prev;
+	t->slot = -1;
+}
+/* (Re)arms the timer. Deadlines already in the past go to the current tick
+ * and fire on the next advance. */
+void timer_arm(struct timer_wheel *w, size_t id, double deadline)
+{
+	timer_cancel(w, id);
+	int64_t tick = timer_tick(deadline);
+	if (tick < w->tick)
+		tick = w->tick;
+	struct timer *t = &w->timers[id];
+	t->deadline = deadline;
+	t->slot = tick & (TIMER_SLOTS - 1);
+	t->prev = -1;
+	t->next = w->head[t->slot];
+	if (t->next >= 0)
+		w->timers[t->next].prev = id;
+	w->head[t->slot] = id;
+}
+
+/* Fires all timers due at time, tick by tick. Timers in a visited slot
+ * which belong to a later round of the wheel are left in place. The due
+ * timers of a slot are unlinked before any of them fires, so callbacks may
+ * freely arm and cancel timers. */
+void timer_advance(struct timer_wheel *w, double time, timer_fn fire, void *arg)
+{
+	int64_t last = timer_tick(time);
+	int64_t first = w->tick;
+	if (last - first >= TIMER_SLOTS)
+		first = last - TIMER_SLOTS + 1;
+	for (int64_t tick = first; tick <= last; ++tick) {
+		int32_t slot = tick & (TIMER_SLOTS - 1);
+		/* so that timers armed by callbacks are not left behind */
+		if (tick > w->tick)
+			w->tick = tick;
+		size_t ndue = 0;
+		for (int32_t i = w->head[slot]; i >= 0; ) {
+			int32_t next = w->timers[i].next;
+			if (w->timers[i].deadline <= time) {
+				timer_cancel(w, i);
+				w->due[ndue++] = i;
+			}
+			i = next;
+		}
+		for (size_t k = 0; k < ndue; ++k)
+			fire(arg, w->due[k]);
+	}
+	/* w->tick stays at the last tick, which may still hold timers due
+	 * later within it */
+}
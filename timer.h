@@ -0,0 +1,62 @@
+/* timer.h - a hashed timer wheel for the simulation's deadlines
+ * Copyright (C) 2026 FreeCG contributors.
+ *
+ * This file is part of FreeCG.
+ *
+ * FreeCG is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * FreeCG is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with FreeCG. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum timer_consts {
+	/* number of slots, must be a power of 2 */
+	TIMER_SLOTS = 256,
+	/* slots per second of simulation time */
+	TIMER_RES = 32
+};
+
+/* A wheel owns a fixed set of timers identified by index. Links are
+ * indices too, so a wheel can be snapshotted by copying its arrays. */
+struct timer {
+	double deadline;
+	/* doubly linked list of a slot, -1 terminates */
+	int32_t prev, next;
+	/* -1 if not armed */
+	int32_t slot;
+};
+struct timer_wheel {
+	size_t ntimers;
+	struct timer *timers;
+	int32_t head[TIMER_SLOTS];
+	/* the earliest tick which may still hold due timers */
+	int64_t tick;
+	/* scratch space for timers being fired */
+	int32_t *due;
+};
+
+/* called once for each timer which fires, with the timer disarmed */
+typedef void (*timer_fn)(void*, size_t);
+
+void timer_wheel_init(struct timer_wheel*, size_t);
+void timer_wheel_free(struct timer_wheel*);
+void timer_arm(struct timer_wheel*, size_t, double);
+void timer_cancel(struct timer_wheel*, size_t);
+int timer_armed(const struct timer_wheel*, size_t);
+void timer_advance(struct timer_wheel*, double, timer_fn, void*);
+
+#endif